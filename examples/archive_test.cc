@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hermes.hh"
+
+struct Point {
+  template<typename Archiver>
+  void serialize(Archiver& ar, unsigned int /*version*/) {
+    ar & x & y;
+  }
+
+  int x;
+  int y;
+};
+
+int failures = 0;
+
+/// Checks that unpacking the bytes given is rejected with std::runtime_error
+template<typename T>
+void expect_rejected(const char* name, const std::string& packed) {
+  T obj;
+  try {
+    hermes::BinaryIArchive iarchive(packed.data(), packed.size());
+    iarchive >> obj;
+    std::cout << "FAIL: " << name << " was accepted" << std::endl;
+    failures++;
+  } catch (std::runtime_error&) {
+    std::cout << "ok: " << name << std::endl;
+  } catch (std::exception& e) {
+    std::cout << "FAIL: " << name << " threw " << e.what() << std::endl;
+    failures++;
+  }
+}
+
+/// Packs obj, then checks that unpacking gives back the same value
+template<typename T>
+void expect_round_trip(const char* name, const T& obj) {
+  hermes::Buffer packed;
+  hermes::BinaryArchiveUnpacker<T>::pack_object(obj, packed);
+  T unpacked;
+  hermes::BinaryArchiveUnpacker<T>::unpack_object(packed.data(), packed.size(), unpacked);
+  if(unpacked == obj) {
+    std::cout << "ok: " << name << std::endl;
+  } else {
+    std::cout << "FAIL: " << name << " changed when unpacked" << std::endl;
+    failures++;
+  }
+}
+
+/// A length prefix, followed by the bytes given
+std::string with_length(hermes::size_type length, const std::string& rest = "") {
+  std::string packed(sizeof(length), '\0');
+  memcpy(&packed[0], &length, sizeof(length));
+  return packed + rest;
+}
+
+int main() {
+  expect_rejected<std::vector<int> >("corrupt vector<int> length", with_length(0xffffffff));
+  expect_rejected<std::vector<std::string> >("corrupt vector<string> length", with_length(0xffffffff));
+  expect_rejected<std::vector<Point> >("corrupt vector<Point> length", with_length(0xffffffff));
+  expect_rejected<std::map<int,std::string> >("corrupt map length", with_length(0xffffffff));
+  expect_rejected<std::string>("corrupt string length", with_length(0xffffffff));
+  expect_rejected<std::vector<int> >("truncated vector<int>", with_length(2, std::string(5, 'x')));
+  expect_rejected<std::vector<std::string> >("truncated vector<string>", with_length(2, with_length(1, "a")));
+  expect_rejected<std::vector<int> >("truncated length", std::string(2, '\0'));
+
+  expect_round_trip("vector<string>", std::vector<std::string>{"a", "", "bcd"});
+  expect_round_trip("map<int,string>", std::map<int,std::string>{{1, "one"}, {2, ""}});
+  expect_round_trip("empty vector<string>", std::vector<std::string>());
+
+  if(failures) {
+    std::cout << failures << " failures" << std::endl;
+    return 1;
+  }
+  return 0;
+}
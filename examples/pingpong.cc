@@ -31,8 +31,8 @@ steady_clock::time_point now() {
 
 
 template<int N>
-void write_msg(hermes::NetworkSocket& socket, const SizedMessage<N>& msg) {
-  socket.write(msg);
+void write_msg(hermes::NetworkSocket& socket, std::unique_ptr<SizedMessage<N> > msg) {
+  socket.write(std::move(msg));
 }
 
 void read_msg(hermes::NetworkSocket& socket) {
@@ -47,11 +47,11 @@ void test_with(hermes::NetworkSocket& socket, bool send_first) {
   auto before = now();
 
   if(send_first) {
-    write_msg(socket, *msg);
+    write_msg(socket, std::move(msg));
     read_msg(socket);
   } else {
     read_msg(socket);
-    write_msg(socket, *msg);
+    write_msg(socket, std::move(msg));
   }
 
   auto after = now();
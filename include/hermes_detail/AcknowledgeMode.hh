@@ -0,0 +1,16 @@
+#ifndef _ACKNOWLEDGEMODE_H_
+#define _ACKNOWLEDGEMODE_H_
+
+namespace hermes {
+  /// Whether messages are acknowledged by the receiving end.
+  /**
+     Acknowledged messages are tracked until the other end confirms receipt,
+       and the NetworkSocket destructor waits for them.
+     Unacknowledged messages are fire-and-forget.
+   */
+  enum class AcknowledgeMode {
+    Acknowledge, NoAcknowledge
+  };
+}
+
+#endif /* _ACKNOWLEDGEMODE_H_ */
@@ -0,0 +1,294 @@
+#ifndef _BINARYARCHIVE_H_
+#define _BINARYARCHIVE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Message.hh"
+
+namespace hermes {
+  /// Base class for archives that save objects
+  /**
+     Objects are saved using the same member function as boost::serialization,
+       "template<typename Archive> void serialize(Archive& ar, unsigned int version)".
+     Arithmetic types and enums are saved as their in-memory representation.
+     Strings, vectors, maps and arrays are supported directly.
+     Lengths are written as a size_type prefix.
+
+     Derived must define "void save_bytes(const void* data, std::size_t size)".
+   */
+  template<typename Derived>
+  class BinaryOArchiveBase {
+  public:
+    typedef std::true_type is_saving;
+    typedef std::false_type is_loading;
+
+    template<typename T>
+    Derived& operator<<(const T& obj) {
+      save(obj);
+      return derived();
+    }
+
+    template<typename T>
+    Derived& operator&(const T& obj) {
+      return *this << obj;
+    }
+
+  private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    save(const T& obj) {
+      derived().save_bytes(&obj, sizeof(T));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_class<T>::value>::type
+    save(const T& obj) {
+      // Same as boost::serialization, serialize is non-const but does not modify when saving.
+      const_cast<T&>(obj).serialize(derived(), 0);
+    }
+
+    template<typename T, std::size_t N>
+    void save(const T (&arr)[N]) {
+      save_range(arr, N);
+    }
+
+    template<typename T, std::size_t N>
+    void save(const std::array<T,N>& arr) {
+      save_range(arr.data(), N);
+    }
+
+    void save(const std::string& str) {
+      save_size(str.size());
+      derived().save_bytes(str.data(), str.size());
+    }
+
+    template<typename T, typename Alloc>
+    void save(const std::vector<T,Alloc>& vec) {
+      save_size(vec.size());
+      save_range(vec.data(), vec.size());
+    }
+
+    template<typename Key, typename Value, typename Compare, typename Alloc>
+    void save(const std::map<Key,Value,Compare,Alloc>& map) {
+      save_size(map.size());
+      for(auto& item : map) {
+        save(item.first);
+        save(item.second);
+      }
+    }
+
+    template<typename First, typename Second>
+    void save(const std::pair<First,Second>& pair) {
+      save(pair.first);
+      save(pair.second);
+    }
+
+    void save_size(std::size_t size) {
+      if(size > max_message_size) {
+        throw std::runtime_error("Container too large to pack");
+      }
+      size_type packed_size = size;
+      derived().save_bytes(&packed_size, sizeof(packed_size));
+    }
+
+    /// Saves contiguous elements, in a single copy if possible
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    save_range(const T* data, std::size_t n) {
+      derived().save_bytes(data, n*sizeof(T));
+    }
+
+    template<typename T>
+    typename std::enable_if<!(std::is_arithmetic<T>::value || std::is_enum<T>::value)>::type
+    save_range(const T* data, std::size_t n) {
+      for(std::size_t i=0; i<n; i++) {
+        save(data[i]);
+      }
+    }
+  };
+
+  /// Counts the bytes that BinaryOArchive would write
+  /**
+     Lets the output buffer be allocated once, at the exact size.
+   */
+  class BinarySizeArchive : public BinaryOArchiveBase<BinarySizeArchive> {
+  public:
+    BinarySizeArchive()
+      : m_size(0) { }
+
+    void save_bytes(const void*, std::size_t size) {
+      m_size += size;
+    }
+
+    /// Number of bytes that would be written so far
+    std::size_t size() const { return m_size; }
+
+  private:
+    std::size_t m_size;
+  };
+
+  /// Writes objects directly into a pre-sized output
+  /**
+     The output must be large enough, as determined by BinarySizeArchive.
+   */
+  class BinaryOArchive : public BinaryOArchiveBase<BinaryOArchive> {
+  public:
+    BinaryOArchive(char* output)
+      : m_output(output) { }
+
+    void save_bytes(const void* data, std::size_t size) {
+      memcpy(m_output, data, size);
+      m_output += size;
+    }
+
+  private:
+    char* m_output;
+  };
+
+  /// Reads objects directly from packed bytes
+  /**
+     Reads the format written by BinaryOArchive.
+     Throws std::runtime_error if the packed bytes are too short.
+   */
+  class BinaryIArchive {
+  public:
+    typedef std::false_type is_saving;
+    typedef std::true_type is_loading;
+
+    BinaryIArchive(const char* packed, std::size_t size)
+      : m_packed(packed), m_remaining(size) { }
+
+    template<typename T>
+    BinaryIArchive& operator>>(T& obj) {
+      load(obj);
+      return *this;
+    }
+
+    template<typename T>
+    BinaryIArchive& operator&(T& obj) {
+      return *this >> obj;
+    }
+
+    /// Number of packed bytes not yet read
+    std::size_t remaining() const { return m_remaining; }
+
+  private:
+    void load_bytes(void* data, std::size_t size) {
+      if(size > m_remaining) {
+        throw std::runtime_error("Packed message shorter than expected");
+      }
+      memcpy(data, m_packed, size);
+      m_packed += size;
+      m_remaining -= size;
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    load(T& obj) {
+      load_bytes(&obj, sizeof(T));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_class<T>::value>::type
+    load(T& obj) {
+      obj.serialize(*this, 0);
+    }
+
+    template<typename T, std::size_t N>
+    void load(T (&arr)[N]) {
+      load_range(arr, N);
+    }
+
+    template<typename T, std::size_t N>
+    void load(std::array<T,N>& arr) {
+      load_range(arr.data(), N);
+    }
+
+    void load(std::string& str) {
+      std::size_t size = load_size(1);
+      str.assign(m_packed, size);
+      m_packed += size;
+      m_remaining -= size;
+    }
+
+    template<typename T, typename Alloc>
+    void load(std::vector<T,Alloc>& vec) {
+      // The length is checked against the remaining bytes,
+      //   so a corrupt length cannot cause a huge allocation.
+      vec.resize(load_size(min_packed_size<T>::value));
+      load_range(vec.data(), vec.size());
+    }
+
+    template<typename Key, typename Value, typename Compare, typename Alloc>
+    void load(std::map<Key,Value,Compare,Alloc>& map) {
+      std::size_t size = load_size(min_packed_size<Key>::value + min_packed_size<Value>::value);
+      map.clear();
+      for(std::size_t i=0; i<size; i++) {
+        std::pair<Key,Value> item;
+        load(item.first);
+        load(item.second);
+        map.insert(std::move(item));
+      }
+    }
+
+    template<typename First, typename Second>
+    void load(std::pair<First,Second>& pair) {
+      load(pair.first);
+      load(pair.second);
+    }
+
+    /// Reads a length prefix, checking that enough bytes remain for the elements
+    /**
+       Every element is assumed to take at least one byte,
+         so that a corrupt length is rejected rather than allocated.
+       Containers of types that pack to no bytes are therefore limited
+         by the size of the message.
+     */
+    std::size_t load_size(std::size_t min_element_size) {
+      size_type size;
+      load_bytes(&size, sizeof(size));
+      min_element_size = std::max<std::size_t>(min_element_size, 1);
+      if(size > m_remaining / min_element_size) {
+        throw std::runtime_error("Packed message shorter than expected");
+      }
+      return size;
+    }
+
+    /// Smallest number of bytes a packed T can take, if known
+    template<typename T>
+    struct min_packed_size {
+      static constexpr std::size_t value =
+        (std::is_arithmetic<T>::value || std::is_enum<T>::value) ? sizeof(T) : 0;
+    };
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    load_range(T* data, std::size_t n) {
+      load_bytes(data, n*sizeof(T));
+    }
+
+    template<typename T>
+    typename std::enable_if<!(std::is_arithmetic<T>::value || std::is_enum<T>::value)>::type
+    load_range(T* data, std::size_t n) {
+      for(std::size_t i=0; i<n; i++) {
+        load(data[i]);
+      }
+    }
+
+    const char* m_packed;
+    std::size_t m_remaining;
+  };
+}
+
+#endif /* _BINARYARCHIVE_H_ */
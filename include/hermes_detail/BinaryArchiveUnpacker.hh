@@ -0,0 +1,57 @@
+#ifndef _BINARYARCHIVEUNPACKER_H_
+#define _BINARYARCHIVEUNPACKER_H_
+
+#include "BinaryArchive.hh"
+#include "MakeUnique.hh"
+#include "MessageUnpacker.hh"
+
+namespace hermes {
+  /// Packs objects with the built-in binary archive
+  /**
+     Uses the same serialize member function as boost::serialization,
+       without requiring boost.
+     Objects are packed directly into the message buffer,
+       and unpacked directly from the received bytes.
+   */
+  template<typename T>
+  class BinaryArchiveUnpacker : public MessageUnpackerType<T> {
+  public:
+    BinaryArchiveUnpacker(id_type id, AcknowledgeMode acknowledge)
+      : MessageUnpackerType<T>(id, acknowledge) { }
+
+    std::unique_ptr<UnpackedMessage> unpack(const char* packed, std::size_t size) const {
+      auto obj = this->acquire_object();
+      unpack_object(packed, size, *obj);
+      return make_unique<UnpackedMessageHolder<T> >(std::move(obj));
+    }
+
+    void unpack_into(const char* packed, std::size_t size, void* voidp) const {
+      unpack_object(packed, size, *static_cast<T*>(voidp));
+    }
+
+    void pack(const void* voidp, Buffer& output) const {
+      pack_object(*static_cast<const T*>(voidp), output);
+    }
+
+    /// Unpacks into an existing object, without a virtual call
+    static void unpack_object(const char* packed, std::size_t size, T& obj) {
+      BinaryIArchive iarchive(packed, size);
+      iarchive >> obj;
+    }
+
+    /// Packs an object, without a virtual call
+    /**
+       The packed size is found first, so that the output is only allocated once.
+     */
+    static void pack_object(const T& obj, Buffer& output) {
+      BinarySizeArchive sizer;
+      sizer << obj;
+      output.resize(sizer.size());
+
+      BinaryOArchive oarchive(output.data());
+      oarchive << obj;
+    }
+  };
+}
+
+#endif /* _BINARYARCHIVEUNPACKER_H_ */
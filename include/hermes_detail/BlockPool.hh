@@ -0,0 +1,38 @@
+#ifndef _BLOCKPOOL_H_
+#define _BLOCKPOOL_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace hermes {
+  /// Pool of raw memory blocks of a single size
+  /**
+     Used for class-specific operator new and delete,
+       for objects allocated on one thread and freed on another.
+     Blocks have the alignment given by ::operator new.
+   */
+  class BlockPool {
+  public:
+    BlockPool(std::size_t block_size, std::size_t max_blocks);
+    ~BlockPool();
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    /// Returns a block, reusing a released block if available
+    void* allocate();
+
+    /// Returns a block to the pool, or frees it if the pool is full
+    void deallocate(void* block);
+
+  private:
+    std::mutex m_mutex;
+    /// Blocks available for reuse
+    std::vector<void*> m_free;
+    std::size_t m_block_size;
+    std::size_t m_max_blocks;
+  };
+}
+
+#endif /* _BLOCKPOOL_H_ */
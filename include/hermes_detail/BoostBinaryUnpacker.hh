@@ -8,32 +8,48 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 
+#include "BufferStreambuf.hh"
+
 namespace hermes {
   template<typename T>
-  class BoostBinaryUnpacker :  public MessageUnpacker {
+  class BoostBinaryUnpacker :  public MessageUnpackerType<T> {
   public:
-    BoostBinaryUnpacker(id_type id)
-      : MessageUnpacker(id) { }
-
-    std::unique_ptr<UnpackedMessage> unpack(const std::string& packed) const {
-      auto obj = make_unique<T>();
-      std::stringstream ss(packed);
-      {
-        boost::archive::binary_iarchive iarchive(ss);
-        iarchive >> *obj;
-      }
+    BoostBinaryUnpacker(id_type id, AcknowledgeMode acknowledge)
+      : MessageUnpackerType<T>(id, acknowledge) { }
+
+    std::unique_ptr<UnpackedMessage> unpack(const char* packed, std::size_t size) const {
+      auto obj = this->acquire_object();
+      unpack_object(packed, size, *obj);
       return make_unique<UnpackedMessageHolder<T> >(std::move(obj));
     }
 
-    std::string pack(const void* voidp) const {
-      auto obj = static_cast<const T*>(voidp);
+    void unpack_into(const char* packed, std::size_t size, void* voidp) const {
+      unpack_object(packed, size, *static_cast<T*>(voidp));
+    }
+
+    void pack(const void* voidp, Buffer& output) const {
+      pack_object(*static_cast<const T*>(voidp), output);
+    }
+
+    /// Unpacks into an existing object, without a virtual call
+    /**
+       Reads directly from the packed bytes.
+     */
+    static void unpack_object(const char* packed, std::size_t size, T& obj) {
+      ArrayStreambuf buf(packed, size);
+      boost::archive::binary_iarchive iarchive(buf, boost::archive::no_header);
+      iarchive >> obj;
+    }
 
-      std::stringstream ss;
-      {
-        boost::archive::binary_oarchive oarchive(ss);
-        oarchive << *obj;
-      }
-      return ss.str();
+    /// Packs an object, without a virtual call
+    /**
+       Writes directly into the output buffer.
+       The archive header is omitted, as both ends already agree on the message type.
+     */
+    static void pack_object(const T& obj, Buffer& output) {
+      BufferStreambuf buf(output);
+      boost::archive::binary_oarchive oarchive(buf, boost::archive::no_header);
+      oarchive << obj;
     }
   };
 }
@@ -44,7 +60,7 @@ namespace hermes {
 
 namespace hermes {
   template<typename T>
-  class BoostBinaryUnpacker : public MessageUnpacker {
+  class BoostBinaryUnpacker : public MessageUnpackerType<T> {
     static_assert(TemplatedBool<T>::False,
                   "To enable use of boost::serialize, -DHERMES_ENABLE_BOOST_SERIALIZE");
   };
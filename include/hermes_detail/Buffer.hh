@@ -0,0 +1,83 @@
+#ifndef _BUFFER_H_
+#define _BUFFER_H_
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+namespace hermes {
+  /// Raw storage for a message body
+  /**
+     Unlike std::string, growing the buffer does not initialize the new bytes.
+     This avoids clearing memory that is about to be overwritten,
+       such as a body about to be read from the network.
+   */
+  class Buffer {
+  public:
+    Buffer()
+      : m_size(0), m_capacity(0) { }
+
+    /// Constructs a buffer of the given size, with uninitialized contents
+    explicit Buffer(std::size_t size)
+      : m_data(new char[size]), m_size(size), m_capacity(size) { }
+
+    Buffer(Buffer&& other) noexcept
+      : m_data(std::move(other.m_data)),
+        m_size(other.m_size), m_capacity(other.m_capacity) {
+      other.m_size = 0;
+      other.m_capacity = 0;
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept {
+      m_data = std::move(other.m_data);
+      m_size = other.m_size;
+      m_capacity = other.m_capacity;
+      other.m_size = 0;
+      other.m_capacity = 0;
+      return *this;
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    char* data() { return m_data.get(); }
+    const char* data() const { return m_data.get(); }
+    std::size_t size() const { return m_size; }
+    std::size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+
+    /// Changes the size of the buffer
+    /**
+       Existing contents are preserved.
+       Any bytes added are left uninitialized.
+     */
+    void resize(std::size_t size) {
+      reserve(size);
+      m_size = size;
+    }
+
+    /// Ensures that the buffer can hold at least the given size without reallocating
+    void reserve(std::size_t capacity) {
+      if(capacity > m_capacity) {
+        std::unique_ptr<char[]> data(new char[capacity]);
+        if(m_size) {
+          memcpy(data.get(), m_data.get(), m_size);
+        }
+        m_data = std::move(data);
+        m_capacity = capacity;
+      }
+    }
+
+    /// Sets the size to zero, keeping the allocation
+    void clear() {
+      m_size = 0;
+    }
+
+  private:
+    std::unique_ptr<char[]> m_data;
+    std::size_t m_size;
+    std::size_t m_capacity;
+  };
+}
+
+#endif /* _BUFFER_H_ */
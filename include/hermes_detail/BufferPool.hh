@@ -0,0 +1,95 @@
+#ifndef _BUFFERPOOL_H_
+#define _BUFFERPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "Buffer.hh"
+
+namespace hermes {
+  /// Pool of reusable message buffers
+  /**
+     Buffers are grouped into size classes by powers of two.
+     A released buffer keeps its allocation,
+       and is handed out again by a later acquire of the same size class.
+     Buffers smaller than min_pooled_size or larger than max_pooled_size
+       are not pooled.
+   */
+  class BufferPool {
+  public:
+    /// Counts of how often the pool was able to reuse a buffer
+    struct Statistics {
+      /// Number of acquires served from the pool
+      std::size_t hits;
+      /// Number of acquires that required a new allocation
+      std::size_t misses;
+      /// Number of buffers returned to the pool
+      std::size_t released;
+      /// Number of buffers freed instead of being returned to the pool
+      std::size_t discarded;
+
+      /// Fraction of acquires served from the pool
+      double hit_rate() const {
+        return (hits + misses) ? double(hits)/(hits + misses) : 0.0;
+      }
+    };
+
+    BufferPool();
+
+    /// Returns a buffer of the requested size
+    /**
+       If a buffer of sufficient capacity is available, it is reused.
+       Otherwise, a new buffer is allocated.
+       The contents of the buffer are uninitialized.
+     */
+    Buffer acquire(std::size_t size);
+
+    /// Returns a buffer to the pool
+    /**
+       If the pool is full, or the buffer is outside the pooled sizes,
+         the buffer is freed instead.
+     */
+    void release(Buffer buffer);
+
+    /// Sets the maximum number of bytes held by the pool
+    void SetMaxPooledBytes(std::size_t max_bytes);
+
+    /// Returns the hit/miss counts of the pool
+    Statistics statistics() const;
+
+    /// Smallest buffer capacity that is pooled
+    static constexpr std::size_t min_pooled_size = 64;
+    /// Largest buffer capacity that is pooled
+    static constexpr std::size_t max_pooled_size = 16*1024*1024;
+    /// Maximum number of buffers held in a single size class
+    static constexpr std::size_t max_buffers_per_class = 64;
+    /// Default maximum number of bytes held by the pool
+    static constexpr std::size_t default_max_pooled_bytes = 64*1024*1024;
+
+  private:
+    /// Size class from which a buffer of the given size can be acquired
+    /**
+       All buffers in this class have at least this capacity.
+     */
+    static std::size_t acquire_class(std::size_t size);
+
+    /// Size class to which a buffer of the given capacity can be released
+    static std::size_t release_class(std::size_t capacity);
+
+    std::mutex m_mutex;
+    /// Free buffers, indexed by size class
+    std::vector<std::vector<Buffer> > m_free;
+    /// Total capacity of all buffers in m_free
+    std::size_t m_pooled_bytes;
+    std::size_t m_max_pooled_bytes;
+
+    std::atomic<std::size_t> m_hits;
+    std::atomic<std::size_t> m_misses;
+    std::atomic<std::size_t> m_released;
+    std::atomic<std::size_t> m_discarded;
+  };
+}
+
+#endif /* _BUFFERPOOL_H_ */
@@ -0,0 +1,67 @@
+#ifndef _BUFFERSTREAMBUF_H_
+#define _BUFFERSTREAMBUF_H_
+
+#include <algorithm>
+#include <cstring>
+#include <streambuf>
+
+#include "Buffer.hh"
+
+namespace hermes {
+  /// A streambuf that appends directly to a Buffer
+  /**
+     Lets stream-based serializers write into a message body,
+       without an intermediate std::stringstream.
+   */
+  class BufferStreambuf : public std::streambuf {
+  public:
+    BufferStreambuf(Buffer& output)
+      : m_output(output) {
+      m_output.clear();
+    }
+
+  protected:
+    std::streamsize xsputn(const char* data, std::streamsize count) {
+      std::size_t size = m_output.size();
+      grow(size + count);
+      m_output.resize(size + count);
+      memcpy(m_output.data() + size, data, count);
+      return count;
+    }
+
+    int_type overflow(int_type ch) {
+      if(traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+      }
+      char c = traits_type::to_char_type(ch);
+      xsputn(&c, 1);
+      return ch;
+    }
+
+  private:
+    /// Reserves space geometrically, so that many small writes stay cheap
+    void grow(std::size_t size) {
+      if(size > m_output.capacity()) {
+        m_output.reserve(std::max(size, 2*m_output.capacity()));
+      }
+    }
+
+    Buffer& m_output;
+  };
+
+  /// A streambuf that reads directly from a range of bytes
+  /**
+     Lets stream-based serializers read from a received message,
+       without copying it into a std::stringstream.
+   */
+  class ArrayStreambuf : public std::streambuf {
+  public:
+    ArrayStreambuf(const char* data, std::size_t size) {
+      // The get area is never written to, despite requiring a non-const pointer.
+      char* begin = const_cast<char*>(data);
+      setg(begin, begin, begin + size);
+    }
+  };
+}
+
+#endif /* _BUFFERSTREAMBUF_H_ */
@@ -0,0 +1,51 @@
+#ifndef _LAZYUNPACKEDMESSAGE_H_
+#define _LAZYUNPACKEDMESSAGE_H_
+
+#include <memory>
+
+#include "Buffer.hh"
+#include "BufferPool.hh"
+#include "MessageUnpacker.hh"
+#include "UnpackedMessage.hh"
+
+namespace hermes {
+  /// A received message, unpacked only once it is viewed or claimed
+  /**
+     Holds the packed body until then.
+     Checking the type with holds<T>() does not unpack.
+   */
+  class LazyUnpackedMessage : public UnpackedMessage {
+  public:
+    /// Constructs the message from its packed body
+    /**
+       The pool keeps the NetworkIO internals, including the unpacker, alive
+         for as long as the message exists.
+       The body is returned to the pool once it is no longer needed.
+     */
+    LazyUnpackedMessage(const MessageUnpacker& unpacker, Buffer body,
+                        std::shared_ptr<BufferPool> pool)
+      : UnpackedMessage(unpacker.type(), true),
+        m_unpacker(unpacker), m_body(std::move(body)), m_pool(std::move(pool)) { }
+
+    ~LazyUnpackedMessage() {
+      m_pool->release(std::move(m_body));
+    }
+
+  protected:
+    UnpackedMessage* unpack_deferred() {
+      if(!m_unpacked) {
+        m_unpacked = m_unpacker.unpack(m_body.data(), m_body.size());
+        m_pool->release(std::move(m_body));
+      }
+      return m_unpacked.get();
+    }
+
+  private:
+    const MessageUnpacker& m_unpacker;
+    Buffer m_body;
+    std::shared_ptr<BufferPool> m_pool;
+    std::unique_ptr<UnpackedMessage> m_unpacked;
+  };
+}
+
+#endif /* _LAZYUNPACKEDMESSAGE_H_ */
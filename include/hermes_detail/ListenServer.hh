@@ -6,6 +6,7 @@
 #include <memory>
 #include <mutex>
 #include <deque>
+#include <vector>
 
 #include "asio.hpp"
 
@@ -24,6 +25,8 @@ public:
   /**
      Shouldn't be called directly.
      Instead, use NetworkIO::listen.
+     If the NetworkIO is sharded, one acceptor is opened on each shard,
+       all bound to the same port with SO_REUSEPORT.
    */
   ListenServer(NetworkIO io,
                asio::ip::tcp::endpoint endpoint);
@@ -52,11 +55,23 @@ private:
    */
   std::unique_ptr<NetworkSocket> pop_if_available();
 
-  void do_accept();
+  /// An acceptor, running on a single io_service.
+  /**
+     Connections accepted here are run by the same io_service.
+   */
+  struct acceptor_t {
+    acceptor_t(asio::io_service& io_service)
+      : acceptor(io_service), socket(io_service) { }
+
+    asio::ip::tcp::acceptor acceptor;
+    asio::ip::tcp::socket socket;
+  };
+
+  void open_acceptor(acceptor_t& acceptor, asio::ip::tcp::endpoint endpoint);
+  void do_accept(acceptor_t& acceptor);
 
   NetworkIO m_io;
-  asio::ip::tcp::acceptor m_acceptor;
-  asio::ip::tcp::socket m_socket;
+  std::vector<std::unique_ptr<acceptor_t> > m_acceptors;
   std::shared_ptr<MessageTemplates> m_message_templates;
 
   std::mutex m_mutex;
@@ -0,0 +1,166 @@
+#ifndef _LOCKFREEQUEUE_H_
+#define _LOCKFREEQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+namespace hermes {
+  /// Multiple-producer, single-consumer queue, without locks
+  /**
+     Any thread may push onto the queue.
+     Only a single thread at a time may pop from the queue.
+     Items are popped all at once, in the order they were pushed.
+
+     Nodes are preallocated, and recycled once popped,
+       so pushing does not allocate while fewer than capacity items are queued.
+     Beyond that, nodes are allocated individually.
+   */
+  template<typename T>
+  class LockFreeQueue {
+    struct Node {
+      Node()
+        : next(nullptr), next_free(no_node), pooled(false) { }
+
+      Node(T value)
+        : value(std::move(value)), next(nullptr), next_free(no_node), pooled(false) { }
+
+      T value;
+      Node* next;
+      /// Index of the next node in the free list
+      std::atomic<std::uint32_t> next_free;
+      /// Whether the node is one of the preallocated nodes
+      bool pooled;
+    };
+
+  public:
+    explicit LockFreeQueue(std::size_t capacity = default_capacity)
+      : m_head(nullptr), m_nodes(new Node[capacity]),
+        m_free(capacity ? 0 : no_node) {
+      for(std::size_t i=0; i<capacity; i++) {
+        m_nodes[i].pooled = true;
+        m_nodes[i].next_free = (i+1 < capacity) ? std::uint32_t(i+1) : no_node;
+      }
+    }
+
+    ~LockFreeQueue() {
+      Node* node = m_head.load();
+      while(node) {
+        Node* next = node->next;
+        if(!node->pooled) {
+          delete node;
+        }
+        node = next;
+      }
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    /// Adds an item to the queue
+    /**
+       May be called from any thread.
+     */
+    void push(T value) {
+      Node* node = acquire_node(std::move(value));
+      node->next = m_head.load(std::memory_order_relaxed);
+      while(!m_head.compare_exchange_weak(node->next, node,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) { }
+    }
+
+    /// Moves all items from the queue onto the end of output
+    /**
+       Items are appended in the order they were pushed.
+       Must only be called by one thread at a time.
+     */
+    void pop_all(std::deque<T>& output) {
+      Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+
+      // Items were taken newest-first, so reverse them.
+      Node* reversed = nullptr;
+      while(node) {
+        Node* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+      }
+
+      while(reversed) {
+        Node* next = reversed->next;
+        output.push_back(std::move(reversed->value));
+        release_node(reversed);
+        reversed = next;
+      }
+    }
+
+    /// Returns whether the queue is currently empty
+    bool empty() const {
+      return m_head.load(std::memory_order_acquire) == nullptr;
+    }
+
+    /// Default number of preallocated nodes
+    static constexpr std::size_t default_capacity = 256;
+
+  private:
+    /// Index marking the end of the free list
+    static constexpr std::uint32_t no_node = UINT32_MAX;
+
+    /// Takes a node from the free list, or allocates one if none are free
+    Node* acquire_node(T&& value) {
+      // The free list head holds a node index in the low 32 bits,
+      //   and a tag in the high 32 bits, incremented on every change.
+      // The tag prevents ABA, as producers pop concurrently.
+      std::uint64_t head = m_free.load(std::memory_order_acquire);
+      while(true) {
+        std::uint32_t index = std::uint32_t(head);
+        if(index == no_node) {
+          return new Node(std::move(value));
+        }
+        std::uint64_t next = m_nodes[index].next_free.load(std::memory_order_relaxed);
+        std::uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+        if(m_free.compare_exchange_weak(head, new_head,
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+          Node& node = m_nodes[index];
+          node.value = std::move(value);
+          return &node;
+        }
+      }
+    }
+
+    /// Returns a popped node to the free list, or deletes it if allocated individually
+    void release_node(Node* node) {
+      if(!node->pooled) {
+        delete node;
+        return;
+      }
+
+      std::uint64_t index = node - m_nodes.get();
+      std::uint64_t head = m_free.load(std::memory_order_relaxed);
+      std::uint64_t new_head;
+      do {
+        node->next_free.store(std::uint32_t(head), std::memory_order_relaxed);
+        new_head = (((head >> 32) + 1) << 32) | index;
+      } while(!m_free.compare_exchange_weak(head, new_head,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+    }
+
+    /// The most recently pushed node
+    std::atomic<Node*> m_head;
+    /// Preallocated nodes
+    std::unique_ptr<Node[]> m_nodes;
+    /// Head of the free list of preallocated nodes
+    std::atomic<std::uint64_t> m_free;
+  };
+
+  template<typename T>
+  constexpr std::size_t LockFreeQueue<T>::default_capacity;
+  template<typename T>
+  constexpr std::uint32_t LockFreeQueue<T>::no_node;
+}
+
+#endif /* _LOCKFREEQUEUE_H_ */
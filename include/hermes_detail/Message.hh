@@ -6,6 +6,7 @@
 #include <memory>
 #include <sstream>
 
+#include "Buffer.hh"
 #include "MakeUnique.hh"
 
 namespace hermes {
@@ -15,9 +16,20 @@ namespace hermes {
 
   union network_header {
     struct packed_t {
+      /// Size of the message body
       size_type size;
+      /// Id of the message type
       id_type id;
+      /// Non-zero if the frame is only an acknowledge, with no message body
       char acknowledge;
+      /// Non-zero if the receiver should not acknowledge this message
+      char no_acknowledge;
+      /// Number of messages in the reverse direction being acknowledged
+      /**
+         May be set on any frame, so that acknowledges can ride along
+           with outgoing messages.
+       */
+      size_type acknowledge_count;
     };
 
     packed_t packed;
@@ -27,7 +39,28 @@ namespace hermes {
 
   struct Message {
     network_header header;
-    std::string body;
+    /// The body of the message, owned by the message
+    Buffer body;
+
+    /// The body of the message, held outside of the message
+    /**
+       If non-null, this is written instead of body, without copying.
+       The external body is kept alive until external_owner is released.
+     */
+    const char* external_body = nullptr;
+    /// Owner of external_body
+    /**
+       Released once the message has been written, or discarded.
+     */
+    std::shared_ptr<const void> external_owner;
+
+    const char* body_data() const {
+      return external_body ? external_body : body.data();
+    }
+
+    std::size_t body_size() const {
+      return external_body ? header.packed.size : body.size();
+    }
   };
 
   // template<typename T>
@@ -3,23 +3,33 @@
 
 #include <functional>
 
+#include "Message.hh"
+#include "ObjectPool.hh"
 #include "UnpackedMessage.hh"
 
 namespace hermes {
   class MessageCallback {
   public:
+    MessageCallback(id_type id)
+      : m_id(id) { }
     virtual ~MessageCallback() { }
     virtual bool apply_on(UnpackedMessage& message) = 0;
+
+    /// The id of the message type handled by this callback
+    id_type id() const { return m_id; }
+
+  private:
+    id_type m_id;
   };
 
   template<typename T>
   class MessageCallbackType : public MessageCallback {
   public:
-    MessageCallbackType(std::function<void(std::unique_ptr<T>)> func)
-      : func(func) { }
+    MessageCallbackType(id_type id, std::function<void(pooled_ptr<T>)> func)
+      : MessageCallback(id), func(func) { }
 
     bool apply_on(UnpackedMessage& message) {
-      auto obj = message.claim<T>();
+      auto obj = message.claim_pooled<T>();
       if(obj) {
         // Message is of correct type, use it
         func(std::move(obj));
@@ -31,7 +41,7 @@ namespace hermes {
     }
 
   private:
-    std::function<void(std::unique_ptr<T>)> func;
+    std::function<void(pooled_ptr<T>)> func;
   };
 }
 
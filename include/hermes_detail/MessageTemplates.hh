@@ -2,100 +2,125 @@
 #define _MESSAGETEMPLATES_H_
 
 #include <algorithm>
+#include <array>
 #include <cassert>
-#include <map>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
-#include "BoostBinaryUnpacker.hh"
-#include "BoostTextUnpacker.hh"
+#include "AcknowledgeMode.hh"
+#include "MakeUnique.hh"
 #include "Message.hh"
 #include "MessageUnpacker.hh"
-#include "PlainOldDataUnpacker.hh"
+#include "ObjectPool.hh"
 #include "PackingMethod.hh"
+#include "UnpackerType.hh"
+#include "VoidPTypeChecker.hh"
 
 namespace hermes {
   class MessageTemplates {
-    template<typename T>
-    struct VoidPTypeChecker {
-      static char x;
-
-      static void* get() {
-        return &x;
-      }
-    };
-
-    template<typename T, PackingMethod Method>
-    struct unpacker_gen;
-
   public:
     MessageTemplates()
-      : highest_id(0) { }
+      : highest_id(0), m_frozen(false) { }
 
     template<typename T, PackingMethod Method>
-    void define() {
+    void define(AcknowledgeMode acknowledge) {
       id_type next_id = highest_id;
-      while(m_templates_by_id.count(next_id)) {
+      while(find_by_id(next_id)) {
         next_id++;
         // Make sure that we don't infinite-loop,
         //   if all 16-bit ids have been used.
         assert(next_id != highest_id);
       }
 
-      define<T,Method>(next_id);
+      define<T,Method>(next_id, acknowledge);
     }
 
     template<typename T,PackingMethod Method>
-    void define(id_type id) {
-      auto voidp = VoidPTypeChecker<T>::get();
-      m_templates_by_class[voidp] = unpacker_gen<T,Method>::construct(id);
-      m_templates_by_id[id] = unpacker_gen<T,Method>::construct(id);
+    void define(id_type id, AcknowledgeMode acknowledge) {
+      if(m_frozen) {
+        throw std::runtime_error("Message types cannot be defined after freezing");
+      }
+
+      m_unpackers.push_back(make_unique<typename UnpackerType<T,Method>::type>(id, acknowledge));
+      const MessageUnpacker* unpacker = m_unpackers.back().get();
+
+      std::size_t index = TypeIndex::get<T>();
+      if(index >= m_templates_by_class.size()) {
+        m_templates_by_class.resize(index + 1, nullptr);
+      }
+      m_templates_by_class[index] = unpacker;
+
+      auto& page = m_templates_by_id[id / page_size];
+      if(!page) {
+        page.reset(new page_t());
+        page->fill(nullptr);
+      }
+      (*page)[id % page_size] = unpacker;
 
       highest_id = std::max(highest_id, id);
     }
 
+    /// Prevents any further message types from being defined
+    /**
+       Lookups never modify the registry,
+         so once frozen, it can be read from any thread without locking.
+     */
+    void freeze() { m_frozen = true; }
+
+    /// Whether freeze has been called
+    bool frozen() const { return m_frozen; }
+
     const MessageUnpacker& get_by_id(id_type id) const {
       // TODO: Throw custom exception, rather than std::out_of_range if not defined
-      return *m_templates_by_id.at(id);
+      auto unpacker = find_by_id(id);
+      if(!unpacker) {
+        throw std::out_of_range("No message type defined with id " + std::to_string(id));
+      }
+      return *unpacker;
     }
 
     template<typename T>
     const MessageUnpacker& get_by_class() const {
-      auto voidp = VoidPTypeChecker<T>::get();
-      return *m_templates_by_class.at(voidp);
-    }
-
-  private:
-
-    template<typename T>
-    struct unpacker_gen<T, PackingMethod::PlainOldData> {
-      static std::unique_ptr<MessageUnpacker> construct(id_type id) {
-        return make_unique<PlainOldDataUnpacker<T> >(id);
-      }
-    };
-
-    template<typename T>
-    struct unpacker_gen<T, PackingMethod::BoostBinaryArchive> {
-      static std::unique_ptr<MessageUnpacker> construct(id_type id) {
-        return make_unique<BoostBinaryUnpacker<T> >(id);
+      std::size_t index = TypeIndex::get<T>();
+      if(index >= m_templates_by_class.size() || !m_templates_by_class[index]) {
+        throw std::out_of_range("Message type not defined");
       }
-    };
+      return *m_templates_by_class[index];
+    }
 
+    /// The pool of unpacked objects of type T
     template<typename T>
-    struct unpacker_gen<T, PackingMethod::BoostTextArchive> {
-      static std::unique_ptr<MessageUnpacker> construct(id_type id) {
-        return make_unique<BoostTextUnpacker<T> >(id);
-      }
-    };
-
+    ObjectPool<T>& pool() const {
+      // Every unpacker for T derives from MessageUnpackerType<T>.
+      return static_cast<const MessageUnpackerType<T>&>(get_by_class<T>()).pool();
+    }
 
+  private:
 
+    /// Returns the unpacker with the given id, or nullptr if none is defined
+    const MessageUnpacker* find_by_id(id_type id) const {
+      auto& page = m_templates_by_id[id / page_size];
+      return page ? (*page)[id % page_size] : nullptr;
+    }
 
-    std::map<id_type, std::unique_ptr<MessageUnpacker> > m_templates_by_id;
-    std::map<void*, std::unique_ptr<MessageUnpacker> > m_templates_by_class;
+    /// Number of ids covered by each page of m_templates_by_id
+    static constexpr std::size_t page_size = 256;
+    typedef std::array<const MessageUnpacker*, page_size> page_t;
+
+    /// Owns all unpackers, which are referred to by the lookup tables
+    std::vector<std::unique_ptr<MessageUnpacker> > m_unpackers;
+    /// Unpackers by id, split into two levels
+    /**
+       A page is only allocated once an id within it is defined.
+     */
+    std::array<std::unique_ptr<page_t>, (UINT16_MAX + 1) / page_size> m_templates_by_id;
+    /// Unpackers by TypeIndex of the message type
+    std::vector<const MessageUnpacker*> m_templates_by_class;
     id_type highest_id;
+    bool m_frozen;
   };
-
-  template<typename T>
-  char MessageTemplates::VoidPTypeChecker<T>::x;
 }
 
 #endif /* _MESSAGETEMPLATES_H_ */
@@ -4,26 +4,88 @@
 #include <memory>
 #include <string>
 
+#include "AcknowledgeMode.hh"
+#include "Buffer.hh"
 #include "UnpackedMessage.hh"
 #include "Message.hh"
+#include "ObjectPool.hh"
+#include "VoidPTypeChecker.hh"
 
 namespace hermes {
-  template<typename T>
-  class MessageUnpackerType;
-
   class MessageUnpacker {
   public:
-    MessageUnpacker(id_type id)
-      : m_id(id) { }
+    /// Constructs the unpacker
+    /**
+       type is the VoidPTypeChecker tag of the message type.
+     */
+    MessageUnpacker(id_type id, AcknowledgeMode acknowledge, void* type)
+      : m_id(id), m_acknowledge(acknowledge), m_type(type) { }
     virtual ~MessageUnpacker() { }
 
-    virtual std::unique_ptr<UnpackedMessage> unpack(const std::string& packed) const = 0;
-    virtual std::string pack(const void*) const = 0;
+    /// Unpacks an object from the packed bytes given
+    virtual std::unique_ptr<UnpackedMessage> unpack(const char* packed, std::size_t size) const = 0;
+    /// Unpacks into an existing object of the message type
+    /**
+       Lets the caller choose where the object lives, such as on the stack.
+     */
+    virtual void unpack_into(const char* packed, std::size_t size, void* obj) const = 0;
+    /// Packs the object into the output buffer
+    /**
+       The output buffer is resized to the packed size.
+       Any previous contents of the buffer are overwritten.
+     */
+    virtual void pack(const void* obj, Buffer& output) const = 0;
+
+    /// Expected size of a packed object, or 0 if unknown
+    /**
+       Used to select a buffer of sufficient size before packing.
+     */
+    virtual std::size_t packed_size_hint() const { return 0; }
+
+    /// Whether the packed form of an object is its own in-memory representation
+    /**
+       If true, an object can be written directly from its own storage,
+         without calling pack.
+     */
+    virtual bool packs_in_place() const { return false; }
 
     id_type id() const { return m_id; }
+    AcknowledgeMode acknowledge() const { return m_acknowledge; }
+    /// The VoidPTypeChecker tag of the message type
+    void* type() const { return m_type; }
 
   private:
     id_type m_id;
+    AcknowledgeMode m_acknowledge;
+    void* m_type;
+  };
+
+  /// Base class of the unpackers for message type T
+  /**
+     Holds the pool that unpacked objects are taken from.
+   */
+  template<typename T>
+  class MessageUnpackerType : public MessageUnpacker {
+  public:
+    MessageUnpackerType(id_type id, AcknowledgeMode acknowledge)
+      : MessageUnpacker(id, acknowledge, VoidPTypeChecker<T>::get()),
+        m_pool(std::make_shared<ObjectPool<T> >()) { }
+
+    /// Pool of unpacked objects, disabled unless NetworkIO::message_pool is called
+    ObjectPool<T>& pool() const { return *m_pool; }
+
+  protected:
+    /// Returns an object to unpack into, taken from the pool if it is enabled
+    pooled_ptr<T> acquire_object() const {
+      if(m_pool->max_objects()) {
+        return pooled_ptr<T>(m_pool->acquire(), PooledDeleter<T>(m_pool));
+      } else {
+        return pooled_ptr<T>(new T());
+      }
+    }
+
+  private:
+    std::shared_ptr<ObjectPool<T> > m_pool;
   };
 }
 
@@ -1,15 +1,25 @@
 #ifndef _NETWORKIO_H_
 #define _NETWORKIO_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <string>
 #include <memory>
 #include <deque>
+#include <vector>
 
 #include "asio.hpp"
+#include "asio/steady_timer.hpp"
 
+#include "AcknowledgeMode.hh"
+#include "BufferPool.hh"
 #include "MessageTemplates.hh"
 #include "PackingMethod.hh"
+#include "StaticMessageSet.hh"
+#include "WaitStrategy.hh"
 
 namespace hermes {
   class NetworkSocket;
@@ -18,9 +28,52 @@ namespace hermes {
   /// Master class, from which sockets are opened.
   class NetworkIO {
   public:
-    NetworkIO();
+    /// How the networking threads divide the work of the sockets.
+    enum class Threading {
+      /// All threads run a single io_service, and any thread may run any socket.
+      Pool,
+      /// Each thread runs its own io_service, pinned to one core where supported.
+      /**
+         A socket stays on the thread it was opened or accepted on,
+           so its state never moves between cores.
+       */
+      Sharded
+    };
+
+    /// Starts the networking threads
+    /**
+       With Threading::Pool, num_threads threads share the work of all sockets opened from here.
+       With Threading::Sharded, each of the num_threads threads owns a shard,
+         and servers listen on every shard with SO_REUSEPORT.
+       Either way, the handlers of any single socket are never run concurrently,
+         so each socket still processes its messages in order.
+
+       If num_threads is 0, no threads are started.
+       The caller must then call poll or run_for regularly,
+         and all networking and callbacks run inline within those calls.
+       Functions that wait, such as NetworkSocket::WaitForMessage,
+         run the networking themselves while waiting.
+       In this mode, all sockets must be used from the polling thread,
+         and callbacks must not wait on their own socket.
+     */
+    explicit NetworkIO(unsigned int num_threads = 1,
+                       Threading threading = Threading::Pool);
     ~NetworkIO();
 
+    /// Runs all networking that is ready, without waiting.
+    /**
+       Returns the number of handlers that were run.
+       Only valid if constructed with num_threads = 0.
+     */
+    std::size_t poll();
+
+    /// Runs networking for the time specified.
+    /**
+       Returns the number of handlers that were run.
+       Only valid if constructed with num_threads = 0.
+     */
+    std::size_t run_for(std::chrono::duration<double> duration);
+
     /// Connect to the port specified
     /**
        Returns a socket object, which can read or write messages
@@ -36,6 +89,7 @@ namespace hermes {
     /// Listen on the specified port
     /**
        Opens the port, listens indefinitely.
+       With Threading::Sharded, each shard accepts its own connections.
      */
     std::unique_ptr<ListenServer> listen(int port);
 
@@ -43,20 +97,83 @@ namespace hermes {
     /**
        Template on the message type that will be passed.
        Uses an auto-incremented message id.
+       With AcknowledgeMode::NoAcknowledge, messages of this type
+         are not acknowledged by the receiver.
      */
     template<typename T, PackingMethod Method = PackingMethod::PlainOldData>
-    void message_type() {
-      internals->message_templates.define<T,Method>();
+    void message_type(AcknowledgeMode acknowledge = AcknowledgeMode::Acknowledge) {
+      internals->message_templates.define<T,Method>(acknowledge);
     }
 
     /// Defines a message that can be passed through any sockets opened from here.
     /**
        Template on the message type that will be passed.
        The id is the unique id of the type, in the message header.
+       With AcknowledgeMode::NoAcknowledge, messages of this type
+         are not acknowledged by the receiver.
      */
     template<typename T, PackingMethod Method = PackingMethod::PlainOldData>
-    void message_type(id_type id) {
-      internals->message_templates.define<T,Method>(id);
+    void message_type(id_type id,
+                      AcknowledgeMode acknowledge = AcknowledgeMode::Acknowledge) {
+      internals->message_templates.define<T,Method>(id, acknowledge);
+    }
+
+    /// Defines every message type of a StaticMessageSet.
+    /**
+       Each type uses the id, packing method and acknowledge mode
+         given in the StaticMessageSet.
+     */
+    template<typename MessageSet>
+    void message_set() {
+      MessageSet::define(internals->message_templates);
+    }
+
+    /// Recycles unpacked messages of type T.
+    /**
+       Up to max_objects objects are kept once released by their consumer,
+         and reused for later messages of the same type.
+       Objects return to the pool when released by a pooled_ptr,
+         such as from UnpackedMessage::claim_pooled or a callback taking a reference.
+       A recycled object is unpacked over its previous contents,
+         so unpacking must overwrite every member.
+       The message type must already have been defined.
+       A max_objects of 0 disables pooling.
+     */
+    template<typename T>
+    void message_pool(std::size_t max_objects) {
+      internals->message_templates.pool<T>().SetMaxObjects(max_objects);
+    }
+
+    /// Prevents any further message types from being defined.
+    /**
+       Message types should all be defined before any messages are passed.
+       Afterwards, message_type throws std::runtime_error.
+     */
+    void freeze_message_types() {
+      internals->message_templates.freeze();
+    }
+
+    /// Sets how threads wait on sockets opened from here.
+    /**
+       Applies to NetworkSocket::WaitForMessage, NetworkSocket::WaitForClose,
+         ListenServer::WaitForConnection, and other internal waits.
+       With WaitStrategy::SpinThenBlock, spins for spin_time before sleeping.
+       When polling, spinning polls the networking rather than sleeping on it.
+       Defaults to WaitStrategy::Block.
+     */
+    void SetWaitStrategy(WaitStrategy strategy,
+                         std::chrono::duration<double> spin_time = default_spin_time);
+
+    /// Default time spent spinning with WaitStrategy::SpinThenBlock
+    static constexpr std::chrono::microseconds default_spin_time{50};
+
+    /// The pool of message buffers used by all sockets opened from here.
+    /**
+       Can be used to limit the memory held by the pool,
+         or to check how often buffers are reused.
+     */
+    BufferPool& buffer_pool() {
+      return internals->buffer_pool;
     }
 
   private:
@@ -67,22 +184,190 @@ namespace hermes {
          instead of needing to maintain it as a shared_ptr.
      */
     struct internals_t {
-      internals_t()
-        : work(io_service) { }
+      /// An io_service, and the threads that run it.
+      struct shard_t {
+        shard_t(unsigned int num_threads)
+          : io_service(num_threads), work(io_service), wake_timer(io_service),
+            wake_timer_armed(false), wake_timer_completions(0) { }
+
+        asio::io_service io_service;
+        asio::io_service::work work;
+        std::vector<std::thread> threads;
+
+        /// Wakes run_one_until at its deadline, when polling
+        /**
+           Reused for every wait, rather than creating a timer each time.
+         */
+        asio::steady_timer wake_timer;
+        /// Whether a wait on wake_timer is pending, and has not been cancelled
+        bool wake_timer_armed;
+        /// Number of wake_timer handlers that have run, including cancelled waits
+        /**
+           Subtracted from the handler counts returned to the caller,
+             as they are not networking.
+         */
+        std::size_t wake_timer_completions;
+      };
+
+      internals_t(unsigned int num_threads, Threading threading);
 
       ~internals_t() {
-        io_service.post(
-          [this]() { io_service.stop(); }
-        );
-        if(thread.joinable()) {
-          thread.join();
+        for(auto& shard : shards) {
+          asio::io_service& io_service = shard->io_service;
+          io_service.post(
+            [&io_service]() { io_service.stop(); }
+          );
         }
+        for(auto& shard : shards) {
+          for(auto& thread : shard->threads) {
+            if(thread.joinable()) {
+              thread.join();
+            }
+          }
+        }
+      }
+
+      /// The io_service on which to open the next outgoing connection.
+      /**
+         Connections are spread over the shards in turn.
+       */
+      asio::io_service& next_io_service() {
+        return shards[next_shard++ % shards.size()]->io_service;
+      }
+
+      /// Whether the caller runs the networking, rather than networking threads.
+      bool polling() const {
+        return num_threads == 0;
+      }
+
+      /// Runs at most one handler, waiting no later than the deadline for one.
+      /**
+         Returns the number of handlers that were run.
+         Only valid when polling.
+       */
+      std::size_t run_one_until(std::chrono::steady_clock::time_point deadline);
+
+      /// Lets other hardware threads progress while spinning.
+      static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+      }
+
+      /// The time until which a wait ending at the deadline should spin.
+      std::chrono::steady_clock::time_point spin_deadline(std::chrono::steady_clock::time_point deadline) const {
+        auto now = std::chrono::steady_clock::now();
+        switch(wait_strategy.load()) {
+        case WaitStrategy::Spin:
+          return deadline;
+
+        case WaitStrategy::SpinThenBlock: {
+          std::chrono::steady_clock::duration spin(spin_time.load());
+          return (deadline - now > spin) ? now + spin : deadline;
+        }
+
+        case WaitStrategy::Block:
+        default:
+          return now;
+        }
+      }
+
+      /// Checks pred() repeatedly until it is true, or until the deadline.
+      /**
+         Returns the final value of pred().
+         The lock is released between checks, so that the handlers may acquire it.
+       */
+      template<typename Predicate>
+      bool spin_until(std::unique_lock<std::mutex>& lock,
+                      std::chrono::steady_clock::time_point deadline, Predicate pred) {
+        while(!pred()) {
+          if(std::chrono::steady_clock::now() >= deadline) {
+            return false;
+          }
+          lock.unlock();
+          if(polling()) {
+            shards[0]->io_service.poll_one();
+          } else {
+            cpu_relax();
+          }
+          lock.lock();
+        }
+        return true;
+      }
+
+      /// Waits on a condition variable until pred() is true.
+      /**
+         Spins first, if requested by the wait strategy.
+         When polling, runs the networking while waiting,
+           with the lock released so that the handlers may acquire it.
+       */
+      template<typename Predicate>
+      void wait(std::unique_lock<std::mutex>& lock, std::condition_variable& cond,
+                Predicate pred) {
+        if(spin_until(lock, spin_deadline(std::chrono::steady_clock::time_point::max()), pred)) {
+          return;
+        }
+
+        if(!polling()) {
+          cond.wait(lock, pred);
+          return;
+        }
+
+        while(!pred()) {
+          lock.unlock();
+          shards[0]->io_service.run_one();
+          lock.lock();
+        }
+      }
+
+      /// Waits on a condition variable until pred() is true, or until the deadline.
+      /**
+         Returns the final value of pred().
+         Spins first, if requested by the wait strategy.
+         When polling, runs the networking while waiting,
+           with the lock released so that the handlers may acquire it.
+       */
+      template<typename Predicate>
+      bool wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& cond,
+                      std::chrono::steady_clock::time_point deadline, Predicate pred) {
+        if(spin_until(lock, spin_deadline(deadline), pred)) {
+          return true;
+        }
+
+        if(!polling()) {
+          return cond.wait_until(lock, deadline, pred);
+        }
+
+        while(!pred()) {
+          if(std::chrono::steady_clock::now() >= deadline) {
+            return false;
+          }
+          lock.unlock();
+          run_one_until(deadline);
+          lock.lock();
+        }
+        return true;
+      }
+
+      /// Waits on a condition variable until pred() is true, or for the duration given.
+      template<typename Predicate>
+      bool wait_for(std::unique_lock<std::mutex>& lock, std::condition_variable& cond,
+                    std::chrono::duration<double> duration, Predicate pred) {
+        auto deadline = std::chrono::steady_clock::now() +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+        return wait_until(lock, cond, deadline, pred);
       }
 
-      asio::io_service io_service;
-      asio::io_service::work work;
+      unsigned int num_threads;
+      Threading threading;
+      std::atomic<WaitStrategy> wait_strategy;
+      std::atomic<std::chrono::steady_clock::rep> spin_time;
+      std::vector<std::unique_ptr<shard_t> > shards;
+      std::atomic<unsigned int> next_shard;
       MessageTemplates message_templates;
-      std::thread thread;
+      BufferPool buffer_pool;
     };
 
     std::shared_ptr<internals_t> internals;
@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <memory>
@@ -11,16 +12,29 @@
 #include <vector>
 
 #include "asio.hpp"
+#include "asio/steady_timer.hpp"
 
+#include "AcknowledgeMode.hh"
+#include "LazyUnpackedMessage.hh"
+#include "LockFreeQueue.hh"
 #include "Message.hh"
 #include "MessageCallback.hh"
 #include "MessageTemplates.hh"
 #include "NetworkIO.hh"
+#include "UnpackMode.hh"
 #include "UnpackedMessage.hh"
 
 namespace hermes {
   class NetworkSocket {
   public:
+    /// What write() does when the write queue is full
+    enum class WriteQueueFull {
+      /// Wait until there is room in the queue
+      Block,
+      /// Throw std::runtime_error
+      Throw
+    };
+
     /// Constructs a socket
     /**
        Shouldn't need to be called directly.
@@ -73,36 +87,159 @@ namespace hermes {
        Returns immediately, asynchronously sending the message.
        The type being passed must have been previously been defined
          with NetworkIO::message_type.
+       If the write queue is full, blocks or throws,
+         as specified by SetWriteQueueLimit.
      */
     template<typename T>
     void write(const T& obj) {
-      auto& unpacker = m_io.internals->message_templates.get_by_class<T>();
-      Message message;
-      message.body = unpacker.pack(&obj);
+      write_direct(pack_message(obj), false);
+    }
+
+    /// Write a message to the socket, if there is room in the write queue
+    /**
+       Returns immediately, asynchronously sending the message.
+       If the write queue is full, returns false without sending the message.
+     */
+    template<typename T>
+    bool try_write(const T& obj) {
+      return write_direct(pack_message(obj), true);
+    }
+
+    /// Write a message to the socket, taking ownership of the object
+    /**
+       Returns immediately, asynchronously sending the message.
+       For plain-old-data messages, the message is written directly
+         from the object, without being copied.
+       The object is deleted once it has been written.
+     */
+    template<typename T>
+    void write(std::unique_ptr<T> obj) {
+      write_in_place(std::shared_ptr<const T>(std::move(obj)));
+    }
+
+    /// Write a message to the socket, without copying the object
+    /**
+       Returns immediately, asynchronously sending the message.
+       For plain-old-data messages, the message is written directly
+         from the caller's object, which must not be modified
+         until on_written has been called.
+       on_written is called once the object may be reused,
+         either after it has been written or after the socket has closed.
+       For other packing methods, the object is packed immediately,
+         and on_written is called before returning.
+     */
+    template<typename T>
+    void write_in_place(const T& obj, std::function<void()> on_written) {
+      write_in_place(std::shared_ptr<const T>(&obj, [on_written](const T*) { on_written(); }));
+    }
 
+    /// Write a message of a StaticMessageSet to the socket
+    /**
+       Returns immediately, asynchronously sending the message.
+       The message is packed without any virtual calls or registry lookups.
+       The receiver must know the message type with the same id,
+         either from the same StaticMessageSet or from NetworkIO::message_type.
+     */
+    template<typename MessageSet, typename T>
+    void write_static(const T& obj) {
+      typedef typename MessageSet::template type_of<T> Type;
+      Message message = new_message(Type::id, Type::acknowledge);
+      message.body = m_io.internals->buffer_pool.acquire(Type::packed_size_hint);
+      Type::unpacker::pack_object(obj, message.body);
       message.header.packed.size = message.body.size();
-      message.header.packed.id = unpacker.id();
-      message.header.packed.acknowledge = 0;
+      write_direct(std::move(message), false);
+    }
+
+    /// Handles all messages of a StaticMessageSet with a visitor
+    /**
+       The visitor must be callable with a reference to each message type in the set.
+       Each message is unpacked onto the stack and passed to the visitor,
+         without virtual calls or heap allocations.
+       Takes precedence over callbacks added with add_callback.
+       Messages received before the visitor takes effect are left for GetMessage,
+         so the types should also be defined with NetworkIO::message_set.
+       Replaces any visitor set previously.
+     */
+    template<typename MessageSet, typename Visitor>
+    void set_static_callbacks(Visitor visitor) {
+      std::function<bool(id_type, const char*, std::size_t)> dispatch =
+        [visitor](id_type id, const char* packed, std::size_t size) mutable {
+          return MessageSet::dispatch(id, packed, size, visitor);
+        };
+      CallbackCounter counter(this);
+      m_strand.post(
+        [this,counter,dispatch]() { m_static_callbacks = dispatch; }
+      );
+    }
+
+    /// Adds a callback receiving the packed bytes of each message with the given id
+    /**
+       The bytes point into the receive buffer,
+         and are only valid for the duration of the callback.
+       No object is allocated, and the id need not be defined with NetworkIO::message_type.
+       Takes precedence over callbacks added with add_callback and add_view_callback.
+       Messages received before the callback takes effect are left for GetMessage.
+       If several callbacks are added for the same id, the first one added is used.
+     */
+    void add_raw_callback(id_type id, std::function<void(id_type, const char*, std::size_t)> func);
 
-      write_direct(std::move(message));
+    /// Adds a callback receiving a reference to each message of a given type
+    /**
+       The message type must already have been defined with NetworkIO::message_type.
+       The reference is only valid for the duration of the callback.
+       Plain-old-data messages are viewed directly in the receive buffer, when aligned,
+         and are otherwise copied onto the stack.
+       Other messages are unpacked onto the stack.
+       Either way, no heap allocation is made for the object.
+       Messages received before the callback takes effect are left for GetMessage.
+     */
+    template<typename T>
+    void add_view_callback(std::function<void(const T&)> func) {
+      const MessageUnpacker* unpacker = &m_io.internals->message_templates.get_by_class<T>();
+      add_raw_callback(unpacker->id(),
+                       [unpacker,func](id_type, const char* packed, std::size_t size) {
+                         view_message<T>(*unpacker, packed, size, func);
+                       });
     }
 
     /// Adds a callback for a given message type.
+    /**
+       The message type must already have been defined with NetworkIO::message_type.
+       If several callbacks are added for the same type, the first one added is used.
+     */
     template<typename T>
     void add_callback(std::function<void(T&)> func) {
-      add_callback<T>([func](std::unique_ptr<T> obj) {
+      add_callback<T>([func](pooled_ptr<T> obj) {
           func(*obj);
         });
     }
 
     /// Adds a callback for a given message type.
+    /**
+       The message type must already have been defined with NetworkIO::message_type.
+       If several callbacks are added for the same type, the first one added is used.
+     */
     template<typename T>
     void add_callback(std::function<void(std::unique_ptr<T>)> func) {
-      auto callback = make_unique<MessageCallbackType<T> >(func);
+      add_callback<T>([func](pooled_ptr<T> obj) {
+          func(std::unique_ptr<T>(obj.release()));
+        });
+    }
+
+    /// Adds a callback for a given message type.
+    /**
+       The message type must already have been defined with NetworkIO::message_type.
+       If several callbacks are added for the same type, the first one added is used.
+       The object returns to the pool given to NetworkIO::message_pool once released.
+     */
+    template<typename T>
+    void add_callback(std::function<void(pooled_ptr<T>)> func) {
+      id_type id = m_io.internals->message_templates.get_by_class<T>().id();
+      auto callback = make_unique<MessageCallbackType<T> >(id, func);
       std::lock_guard<std::mutex> lock(m_new_callback_mutex);
       m_new_callbacks.push_back(std::move(callback));
       CallbackCounter counter(this);
-      m_io.internals->io_service.post(
+      m_strand.post(
         [this,counter]() { initialize_callback(); }
       );
     }
@@ -127,7 +264,162 @@ namespace hermes {
     /// How many messages are queued to be written.
     int WriteMessagesQueued();
 
+    /// Limits the number of received messages waiting to be retrieved
+    /**
+       Once max_messages messages are waiting, the socket stops reading.
+       TCP flow control then slows down the sender,
+         without any messages being dropped.
+       Reading resumes once GetMessage or WaitForMessage has reduced
+         the number of waiting messages to resume_messages.
+       Messages handled by callbacks do not count towards the limit.
+       A max_messages of 0 leaves the number unlimited.
+     */
+    void SetReadQueueLimit(std::size_t max_messages, std::size_t resume_messages);
+
+    /// How many bytes are queued to be written, including headers.
+    std::size_t WriteBytesQueued();
+
+    /// Limits the size of the write queue
+    /**
+       Once max_messages messages or max_bytes bytes are queued,
+         write() will block or throw, as specified by policy,
+         and try_write() will return false.
+       A value of 0 leaves that quantity unlimited.
+       A single message is always accepted by an empty queue,
+         even if it exceeds max_bytes.
+       The limit is checked without locking,
+         so concurrent writers may overshoot it slightly.
+     */
+    void SetWriteQueueLimit(std::size_t max_messages, std::size_t max_bytes,
+                            WriteQueueFull policy = WriteQueueFull::Block);
+
+    /// Sets a callback for when a full write queue has drained
+    /**
+       After the write queue has reached its limit,
+         the callback is called once the queue has drained to
+         at most max_messages messages and max_bytes bytes.
+       The callback is called from a networking thread.
+     */
+    void SetWriteQueueLowWater(std::size_t max_messages, std::size_t max_bytes,
+                               std::function<void()> callback);
+
+    /// Limits how much of the write queue is sent in a single write
+    /**
+       All queued messages are gathered into a single write,
+         up to max_messages messages or max_bytes bytes, including headers.
+       A batch is also limited to max_write_buffers buffers,
+         so that it is sent with a single system call.
+       At least one message is always sent, regardless of max_bytes.
+     */
+    void SetWriteBatchLimit(std::size_t max_messages, std::size_t max_bytes);
+
+    /// Maximum number of buffers gathered into a single write
+    /**
+       asio passes at most 64 buffers to each writev,
+         and splits longer buffer sequences into several system calls.
+       Each message uses one buffer for its header, and one for any body.
+     */
+    static constexpr std::size_t max_write_buffers = 64;
+    /// Default maximum number of messages in a single write
+    static constexpr std::size_t default_write_batch_messages = max_write_buffers / 2;
+    /// Default maximum number of bytes in a single write
+    static constexpr std::size_t default_write_batch_bytes = 1024*1024;
+
+    /// Sets how long received messages may wait before being acknowledged
+    /**
+       Rather than acknowledging each message as it arrives,
+         a single cumulative acknowledge is sent for all messages
+         received within the interval.
+       If a message is written within the interval,
+         the acknowledge is carried in its header instead.
+     */
+    void SetAcknowledgeInterval(std::chrono::duration<double> interval);
+
+    /// Default delay before acknowledging received messages
+    static constexpr std::chrono::milliseconds default_acknowledge_interval{1};
+
+    /// Size of the buffer used for reading from the socket
+    /**
+       Each read fills as much of the buffer as is available,
+         and all complete messages in it are handled together.
+       Messages larger than this are read directly into their own buffer.
+     */
+    static constexpr std::size_t read_buffer_size = 64*1024;
+
+    /// Sets whether messages written to this socket request an acknowledge
+    /**
+       With AcknowledgeMode::NoAcknowledge, all messages written are fire-and-forget,
+         regardless of the mode of the message type.
+       The destructor does not wait for unacknowledged messages to be received.
+     */
+    void SetAcknowledgeMode(AcknowledgeMode acknowledge);
+
+    /// Sets when received messages are unpacked
+    /**
+       With UnpackMode::Lazy, messages are queued still packed,
+         and unpacked by the thread that first views or claims them.
+       This keeps expensive unpacking off the networking thread,
+         and messages that are discarded are never unpacked.
+       Messages with a callback are still unpacked on the networking thread.
+       Defaults to UnpackMode::Eager.
+     */
+    void SetUnpackMode(UnpackMode mode);
+
   private:
+    /// Packs an object into a message, ready to be written
+    template<typename T>
+    Message pack_message(const T& obj) {
+      auto& unpacker = m_io.internals->message_templates.get_by_class<T>();
+      Message message = new_message(unpacker);
+      message.body = m_io.internals->buffer_pool.acquire(unpacker.packed_size_hint());
+      unpacker.pack(&obj, message.body);
+      message.header.packed.size = message.body.size();
+      return message;
+    }
+
+    /// Write a message to the socket, without copying the object if possible
+    /**
+       The object is released once it has been written.
+     */
+    template<typename T>
+    void write_in_place(std::shared_ptr<const T> obj) {
+      auto& unpacker = m_io.internals->message_templates.get_by_class<T>();
+      Message message = new_message(unpacker);
+      if(unpacker.packs_in_place()) {
+        message.external_body = reinterpret_cast<const char*>(obj.get());
+        message.header.packed.size = sizeof(T);
+        message.external_owner = std::move(obj);
+      } else {
+        message.body = m_io.internals->buffer_pool.acquire(unpacker.packed_size_hint());
+        unpacker.pack(obj.get(), message.body);
+        message.header.packed.size = message.body.size();
+      }
+
+      write_direct(std::move(message), false);
+    }
+
+    /// Makes a message with the header filled for the type given
+    /**
+       The size of the message must still be set by the caller.
+     */
+    Message new_message(const MessageUnpacker& unpacker) {
+      return new_message(unpacker.id(), unpacker.acknowledge());
+    }
+
+    /// Makes a message with the header filled for the id given
+    /**
+       The size of the message must still be set by the caller.
+     */
+    Message new_message(id_type id, AcknowledgeMode acknowledge) {
+      Message message;
+      message.header.packed.id = id;
+      message.header.packed.acknowledge = 0;
+      message.header.packed.no_acknowledge =
+        (m_acknowledge_writes && acknowledge == AcknowledgeMode::Acknowledge) ? 0 : 1;
+      message.header.packed.acknowledge_count = 0;
+      return message;
+    }
+
     /// Helper struct, keeping track of the number of callbacks registered
     /**
        We can't let the NetworkSocket destructor end until all callbacks refering to it are done.
@@ -167,30 +459,80 @@ namespace hermes {
     /// Initializes socket settings, then starts the chain of async_read
     /**
        Sets the "linger" option, so the socket won't prematurely close.
-       Calls do_read_header on the networking thread.
+       Disables Nagle's algorithm, since writes are batched by the writer.
+       Calls do_read within m_strand.
      */
     void start_read_loop();
 
     /// Write a packed message on the socket
     /**
        Called by write(), after packing the message.
+       If the write queue is full, and try_only is true, returns false.
+       If the write queue is full, and try_only is false,
+         blocks or throws according to the write queue policy.
+       Returns true if the message was queued.
+     */
+    bool write_direct(Message message, bool try_only);
+
+    /// Returns whether a message of the given size fits in the write queue
+    bool write_queue_has_room(std::size_t message_bytes);
+
+    /// Removes a written batch from the write queue counts
+    /**
+       Wakes any writers blocked on a full queue,
+         and calls the low-water callback if the queue has drained.
+     */
+    void write_batch_finished(std::size_t messages, std::size_t bytes);
+
+    /// Read as much as is available from the socket
+    /**
+       Reads into the free space at the end of m_read_buffer.
+       On success, chains into parse_read_buffer().
      */
-    void write_direct(Message message);
+    void do_read();
 
-    /// Read a single header from the socket
+    /// Handle all complete frames in m_read_buffer
     /**
-       Reads into m_current_read.header.
-       If the header is an acknowledge, record it and read another header.
-       If the header is not an acknowledge, read the body of the message.
+       Every complete frame in the buffer is handled, without further reads.
+       Any partial frame is moved to the front of the buffer,
+         then chains into do_read() to read the remainder.
+       If the read queue is full, stops without calling do_read(),
+         leaving any remaining frames in the buffer.
+       If a frame is too large to ever fit in the buffer,
+         chains into do_read_large_body() instead.
+     */
+    void parse_read_buffer();
+
+    /// Read the body of a message too large for m_read_buffer
+    /**
+       Reads into m_current_read.body, drawn from the buffer pool.
+       Any part of the body already in m_read_buffer is copied first.
+       On success, handles the message, then chains into parse_read_buffer().
+     */
+    void do_read_large_body(network_header header);
+
+    /// Restarts the read loop, if it was stopped by a full read queue
+    /**
+       Must be called within m_strand.
+     */
+    void resume_reading();
+
+    /// Resumes reading if the read queue has drained enough
+    /**
+       Assumes that the caller has already acquired the m_read_lock mutex.
      */
-    void do_read_header();
+    void resume_if_drained();
 
-    /// Read the body of a message from the socket.
+    /// Records any acknowledges carried by a header
+    void receive_acknowledges(const network_header& header);
+
+    /// Handles the body of a message received
     /**
-       Reads into m_current_read.body.
-       On success, calls unpack_message(), then chains into do_read_header().
+       Schedules an acknowledge of the message, if requested,
+         then unpacks the message.
      */
-    void do_read_body();
+    void receive_message(const network_header& header, const char* body, std::size_t size,
+                         Buffer* owned_body = nullptr);
 
     /// Pops from m_read_messages, if something is available
     /**
@@ -202,35 +544,68 @@ namespace hermes {
     /// Unpacks a message, places in m_read_messages
     /**
        Uses the unpacker stored in m_io.internals->message_templates.
+       If unpacking is lazy, the packed body is queued instead.
+       If owned_body is given, it holds the body, and may be taken rather than copied.
+     */
+    void unpack_message(id_type id, const char* body, std::size_t size,
+                        Buffer* owned_body = nullptr);
+
+    /// Starts the acknowledge timer, if it is not already running.
+    /**
+       When the timer expires, any messages received but not yet acknowledged
+         by an outgoing message are acknowledged at once.
+     */
+    void schedule_acknowledge();
+
+    /// Writes a cumulative acknowledge of messages received.
+    /**
+       Accepts the number of messages being acknowledged.
+       The acknowledge is a header with the acknowledge field set,
+         and with the count stored in the acknowledge_count field.
      */
-    void unpack_message();
+    void write_acknowledge(size_type count);
 
-    /// Writes an acknowledge of a full message received.
+    /// Immediately acknowledges any messages received, but not yet acknowledged
     /**
-       Accepts the header of the message being acknowledged.
-       The acknowledge is the same header, but with the acknowledge field set.
+       Called before closing, so that the peer is not left waiting
+         on the acknowledge timer.
+       Only called within m_strand.
      */
-    void write_acknowledge(network_header header);
+    void flush_acknowledges();
 
     /// Start the writer, if the writer is not already running.
+    /**
+       Only posts to m_strand if the writer is idle.
+     */
     void start_writer();
 
-    /// Write a single header
+    /// Write a batch of messages
     /**
-       Pulls a message out of m_write_message,
-         then writes its header onto the network.
-       If the header is an acknowledge, chain into do_write_header.
-       If the header is not an acknowledge, chain into do_write_body.
+       Pulls as many messages out of m_write_queue as allowed
+         by the write batch limit, then writes all of their headers
+         and bodies onto the network as a single gathered write.
+       Any pending acknowledges are carried in the first header of the batch.
+       On completion, chains into do_write.
      */
-    void do_write_header();
+    void do_write();
 
-    /// Write the body of a message
+    /// Passes a message to func, without allocating the object
     /**
-       Writes the body from m_current_write.body.
-       Should only be called from in do_write_header.
-       On completion, chains into do_write_header.
+       If the packed bytes are the object itself, and suitably aligned,
+         they are used in place.
      */
-    void do_write_body();
+    template<typename T>
+    static void view_message(const MessageUnpacker& unpacker, const char* packed, std::size_t size,
+                             const std::function<void(const T&)>& func) {
+      if(unpacker.packs_in_place() && size == sizeof(T) &&
+         reinterpret_cast<std::uintptr_t>(packed) % alignof(T) == 0) {
+        func(*reinterpret_cast<const T*>(packed));
+      } else {
+        T obj;
+        unpacker.unpack_into(packed, size, &obj);
+        func(obj);
+      }
+    }
 
     /// Initialize a single callback
     /**
@@ -243,10 +618,17 @@ namespace hermes {
     /// The NetworkIO running the socket.
     /**
        We use the unpackers defined here.
-       Holding the NetworkIO keeps the networking thread open.
+       Holding the NetworkIO keeps the networking threads open.
      */
     NetworkIO m_io;
     asio::ip::tcp::socket m_socket;
+    /// Strand on which all handlers for this socket run
+    /**
+       The io_service may be run by several threads.
+       The strand ensures that handlers for a single socket never run concurrently,
+         and run in the order they were posted.
+     */
+    asio::io_service::strand m_strand;
 
     /// Mutex for configuring the socket
     /**
@@ -269,8 +651,29 @@ namespace hermes {
     /// Condition variable for waiting on the socket to close
     std::condition_variable m_socket_closed;
 
-    /// The current message being read from the socket
+    /// Buffer holding bytes read from the socket, but not yet handled
+    Buffer m_read_buffer;
+    /// Start of the bytes in m_read_buffer not yet handled
+    std::size_t m_read_start;
+    /// End of the bytes in m_read_buffer read from the socket
+    std::size_t m_read_end;
+    /// The current message being read, if too large for m_read_buffer
     Message m_current_read;
+    /// Maximum number of messages in m_read_messages, or 0 if unlimited
+    std::atomic<std::size_t> m_read_queue_max_messages;
+    /// Number of messages in m_read_messages at which reading resumes
+    std::atomic<std::size_t> m_read_queue_resume_messages;
+    /// Whether reading should stop, because m_read_messages is full
+    /**
+       Set within m_strand, and cleared by consumers,
+         both with m_read_lock held.
+     */
+    std::atomic_bool m_read_paused;
+    /// Whether the read loop has stopped, due to m_read_paused
+    /**
+       Only accessed within m_strand.
+     */
+    bool m_read_loop_stopped;
     /// Additional messages, already having been read from the socket
     std::deque<std::unique_ptr<UnpackedMessage> > m_read_messages;
     /// A lock around m_read_messages
@@ -279,13 +682,68 @@ namespace hermes {
     std::condition_variable m_received_message;
 
     /// Messages being queued up to write
+    /**
+       Any thread may push onto the queue,
+         without waiting on the networking threads.
+     */
+    LockFreeQueue<Message> m_write_queue;
+    /// Messages taken from m_write_queue, but not yet written
+    /**
+       Only accessed within m_strand.
+     */
     std::deque<Message> m_write_messages;
-    /// The current message being written
-    Message m_current_write;
+    /// Number of messages queued, but not yet passed to the OS
+    std::atomic_int m_write_messages_queued;
+    /// Number of bytes queued, but not yet passed to the OS
+    std::atomic<std::size_t> m_write_bytes_queued;
+    /// Bytes in the batch currently being written
+    std::size_t m_current_write_bytes;
+
+    /// Maximum number of messages in the write queue, or 0 if unlimited
+    std::atomic<std::size_t> m_write_queue_max_messages;
+    /// Maximum number of bytes in the write queue, or 0 if unlimited
+    std::atomic<std::size_t> m_write_queue_max_bytes;
+    /// What write() does when the queue is full
+    std::atomic<WriteQueueFull> m_write_queue_policy;
+    /// Whether the write queue has been full since the last low-water callback
+    std::atomic_bool m_write_queue_was_full;
+    /// Mutex for waiting on room in the write queue
+    std::mutex m_write_space_mutex;
+    /// Triggered when a batch has been written
+    /**
+       Also triggered once the write queue is empty, if m_flushing_writes is set.
+     */
+    std::condition_variable m_write_space;
+    /// Whether flush_acknowledges has run, and the destructor waits for the write queue to empty
+    std::atomic_bool m_flushing_writes;
+    /// Low-water mark, in messages
+    std::size_t m_write_low_water_messages;
+    /// Low-water mark, in bytes
+    std::size_t m_write_low_water_bytes;
+    /// Called when a full write queue drains to the low-water mark
+    /**
+       The low-water settings are guarded by m_write_space_mutex.
+     */
+    std::function<void()> m_write_low_water_callback;
+    /// The current batch of messages being written
+    std::vector<Message> m_current_writes;
+    /// Buffers for the headers and bodies of m_current_writes
+    std::vector<asio::const_buffer> m_write_buffers;
     /// Whether or not the writer is currently running
+    /**
+       Set by whichever thread starts the writer,
+         and cleared by the writer once the queue is empty.
+     */
     std::atomic_bool m_writer_running;
-    /// Lock around m_write_messages
-    std::mutex m_write_lock;
+    /// Maximum number of messages in a single write
+    std::atomic<std::size_t> m_write_batch_messages;
+    /// Maximum number of bytes in a single write
+    std::atomic<std::size_t> m_write_batch_bytes;
+
+    /// Whether messages written request an acknowledge
+    std::atomic_bool m_acknowledge_writes;
+    /// Whether received messages are queued without unpacking
+    std::atomic_bool m_unpack_lazily;
 
     /// Count of messages sent, but not acknowledged
     /**
@@ -300,14 +758,43 @@ namespace hermes {
     /// Called whenever the unacknowledged messages goes down to 0
     std::condition_variable m_all_messages_acknowledged;
 
+    /// Timer for sending cumulative acknowledges
+    asio::steady_timer m_acknowledge_timer;
+    /// Delay between receiving a message and acknowledging it
+    /**
+       Only accessed within m_strand.
+     */
+    std::chrono::steady_clock::duration m_acknowledge_interval;
+    /// Whether m_acknowledge_timer is currently waiting
+    bool m_acknowledge_scheduled;
+    /// Number of messages received, but not yet acknowledged
+    /**
+       Only accessed within m_strand.
+     */
+    size_type m_unsent_acknowledges;
+
     /// List of callbacks defined but not yet initialized
     std::deque<std::unique_ptr<MessageCallback> > m_new_callbacks;
     /// Mutex around new callbacks
     std::mutex m_new_callback_mutex;
-    /// List of initialized callbacks
+    /// Dispatch to the visitor given to set_static_callbacks
+    /**
+       Returns false if the message is not part of the StaticMessageSet.
+       Only accessed within m_strand, so no mutex is needed.
+     */
+    std::function<bool(id_type, const char*, std::size_t)> m_static_callbacks;
+    /// Callbacks added with add_raw_callback, indexed by message id
+    /**
+       Only accessed within m_strand, so no mutex is needed.
+       Ids without a callback hold an empty function.
+     */
+    std::vector<std::function<void(id_type, const char*, std::size_t)> > m_raw_callbacks;
+    /// Initialized callbacks, indexed by message id
+    /**
+       Only accessed within m_strand, so no mutex is needed.
+       Ids without a callback hold nullptr.
+     */
     std::vector<std::unique_ptr<MessageCallback> > m_callbacks;
-    /// Mutex around initialized callbacks
-    std::mutex m_callback_mutex;
   };
 }
 
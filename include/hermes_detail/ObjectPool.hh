@@ -0,0 +1,118 @@
+#ifndef _OBJECTPOOL_H_
+#define _OBJECTPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hermes {
+  /// Pool of reusable objects of a single type
+  /**
+     A released object is kept as-is, and handed out again by a later acquire,
+       so any memory it owns is reused as well.
+     Holds no objects until SetMaxObjects is called.
+     May be used from any thread.
+   */
+  template<typename T>
+  class ObjectPool {
+  public:
+    ObjectPool()
+      : m_max_objects(0) { }
+
+    ~ObjectPool() {
+      for(T* obj : m_free) {
+        delete obj;
+      }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /// Returns a recycled object, or a new default-constructed object
+    /**
+       A recycled object still holds whatever state it was released with.
+       The object is always allocated with new,
+         so it may be deleted rather than released.
+     */
+    T* acquire() {
+      if(m_max_objects) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(!m_free.empty()) {
+          T* obj = m_free.back();
+          m_free.pop_back();
+          return obj;
+        }
+      }
+      return new T();
+    }
+
+    /// Returns an object to the pool, or deletes it if the pool is full
+    void release(T* obj) {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_free.size() < m_max_objects) {
+          m_free.push_back(obj);
+          return;
+        }
+      }
+      delete obj;
+    }
+
+    /// Sets the maximum number of objects held by the pool
+    /**
+       A max_objects of 0 disables pooling.
+     */
+    void SetMaxObjects(std::size_t max_objects) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_max_objects = max_objects;
+      while(m_free.size() > max_objects) {
+        delete m_free.back();
+        m_free.pop_back();
+      }
+      // Releasing should never need to allocate.
+      m_free.reserve(max_objects);
+    }
+
+    /// Maximum number of objects held by the pool
+    std::size_t max_objects() const { return m_max_objects; }
+
+  private:
+    std::mutex m_mutex;
+    /// Objects available for reuse
+    std::vector<T*> m_free;
+    std::atomic<std::size_t> m_max_objects;
+  };
+
+  /// Deleter returning objects to an ObjectPool
+  /**
+     Without a pool, the object is deleted.
+     Holding the pool keeps it alive for as long as any of its objects are in use.
+   */
+  template<typename T>
+  class PooledDeleter {
+  public:
+    PooledDeleter() { }
+
+    explicit PooledDeleter(std::shared_ptr<ObjectPool<T> > pool)
+      : m_pool(std::move(pool)) { }
+
+    void operator()(T* obj) const {
+      if(m_pool) {
+        m_pool->release(obj);
+      } else {
+        delete obj;
+      }
+    }
+
+  private:
+    std::shared_ptr<ObjectPool<T> > m_pool;
+  };
+
+  /// An object that returns to its ObjectPool when destroyed
+  template<typename T>
+  using pooled_ptr = std::unique_ptr<T, PooledDeleter<T> >;
+}
+
+#endif /* _OBJECTPOOL_H_ */
@@ -2,7 +2,7 @@
 #define _PACKINGMETHOD_H_
 
 enum class PackingMethod {
-  PlainOldData, BoostBinaryArchive, BoostTextArchive
+  PlainOldData, BoostBinaryArchive, BoostTextArchive, BinaryArchive
 };
 
 #endif /* _PACKINGMETHOD_H_ */
@@ -10,28 +10,45 @@
 
 namespace hermes {
   template<typename T>
-  class PlainOldDataUnpacker : public MessageUnpacker {
+  class PlainOldDataUnpacker : public MessageUnpackerType<T> {
     static_assert(std::is_pod<T>::value,
                   "PlainOldDataUnpacker requires type to be plain-old-data");
   public:
-    PlainOldDataUnpacker(id_type id)
-      : MessageUnpacker(id) { }
+    PlainOldDataUnpacker(id_type id, AcknowledgeMode acknowledge)
+      : MessageUnpackerType<T>(id, acknowledge) { }
 
-    std::unique_ptr<UnpackedMessage> unpack(const std::string& packed) const {
-      assert(packed.size() == sizeof(T));
-
-      auto obj = make_unique<T>();
-      memcpy(&*obj, packed.data(), std::min(packed.size(),sizeof(T)));
+    std::unique_ptr<UnpackedMessage> unpack(const char* packed, std::size_t size) const {
+      auto obj = this->acquire_object();
+      unpack_object(packed, size, *obj);
       return make_unique<UnpackedMessageHolder<T> >(std::move(obj));
     }
 
-    std::string pack(const void* voidp) const {
-      auto obj = static_cast<const T*>(voidp);
+    void unpack_into(const char* packed, std::size_t size, void* voidp) const {
+      unpack_object(packed, size, *static_cast<T*>(voidp));
+    }
+
+    void pack(const void* voidp, Buffer& output) const {
+      pack_object(*static_cast<const T*>(voidp), output);
+    }
+
+    /// Unpacks into an existing object, without a virtual call
+    static void unpack_object(const char* packed, std::size_t size, T& obj) {
+      assert(size == sizeof(T));
+      memcpy(&obj, packed, std::min(size,sizeof(T)));
+    }
 
-      std::string output;
+    /// Packs an object, without a virtual call
+    static void pack_object(const T& obj, Buffer& output) {
       output.resize(sizeof(T));
-      memcpy(&output[0], obj, sizeof(T));
-      return output;
+      memcpy(output.data(), &obj, sizeof(T));
+    }
+
+    std::size_t packed_size_hint() const {
+      return sizeof(T);
+    }
+
+    bool packs_in_place() const {
+      return true;
     }
   };
 }
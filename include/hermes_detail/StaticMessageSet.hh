@@ -0,0 +1,390 @@
+#ifndef _STATICMESSAGESET_H_
+#define _STATICMESSAGESET_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "AcknowledgeMode.hh"
+#include "Buffer.hh"
+#include "Message.hh"
+#include "MessageTemplates.hh"
+#include "PackingMethod.hh"
+#include "TemplatedBool.hh"
+#include "UnpackerType.hh"
+
+namespace hermes {
+  /// A single message type within a StaticMessageSet
+  /**
+     T is the type of the message, sent with the given id.
+   */
+  template<typename T, id_type Id,
+           PackingMethod Method = PackingMethod::PlainOldData,
+           AcknowledgeMode Acknowledge = AcknowledgeMode::Acknowledge>
+  struct StaticMessageType {
+    typedef T type;
+    typedef typename UnpackerType<T,Method>::type unpacker;
+
+    static constexpr id_type id = Id;
+    static constexpr PackingMethod method = Method;
+    static constexpr AcknowledgeMode acknowledge = Acknowledge;
+    /// Size of buffer to request before packing, or 0 if unknown
+    static constexpr std::size_t packed_size_hint =
+      (Method == PackingMethod::PlainOldData) ? sizeof(T) : 0;
+  };
+
+  template<typename T, id_type Id, PackingMethod Method, AcknowledgeMode Acknowledge>
+  constexpr id_type StaticMessageType<T,Id,Method,Acknowledge>::id;
+  template<typename T, id_type Id, PackingMethod Method, AcknowledgeMode Acknowledge>
+  constexpr PackingMethod StaticMessageType<T,Id,Method,Acknowledge>::method;
+  template<typename T, id_type Id, PackingMethod Method, AcknowledgeMode Acknowledge>
+  constexpr AcknowledgeMode StaticMessageType<T,Id,Method,Acknowledge>::acknowledge;
+  template<typename T, id_type Id, PackingMethod Method, AcknowledgeMode Acknowledge>
+  constexpr std::size_t StaticMessageType<T,Id,Method,Acknowledge>::packed_size_hint;
+
+  namespace static_message_detail {
+    template<typename T>
+    struct identity {
+      typedef T type;
+    };
+
+    /// Finds the StaticMessageType whose message type is T
+    template<typename T, typename... Types>
+    struct find_type {
+      static_assert(TemplatedBool<T>::False,
+                    "Message type is not part of the StaticMessageSet");
+      typedef void type;
+    };
+
+    template<typename T, typename First, typename... Rest>
+    struct find_type<T, First, Rest...> {
+      typedef typename std::conditional<std::is_same<T, typename First::type>::value,
+                                        identity<First>,
+                                        find_type<T, Rest...> >::type::type type;
+    };
+
+    /// Position of the StaticMessageType whose message type is T
+    template<typename T, typename... Types>
+    struct index_of;
+
+    template<typename T, typename First, typename... Rest>
+    struct index_of<T, First, Rest...> {
+      static constexpr std::size_t value =
+        std::is_same<T, typename First::type>::value ? 0 : 1 + index_of<T, Rest...>::value;
+    };
+
+    template<typename T>
+    struct index_of<T> {
+      static constexpr std::size_t value = 0;
+    };
+
+    /// Whether any of the StaticMessageTypes uses the id given
+    template<id_type Id, typename... Types>
+    struct uses_id {
+      static constexpr bool value = false;
+    };
+
+    template<id_type Id, typename First, typename... Rest>
+    struct uses_id<Id, First, Rest...> {
+      static constexpr bool value = (First::id == Id) || uses_id<Id, Rest...>::value;
+    };
+
+    /// Whether each StaticMessageType has a different id
+    template<typename... Types>
+    struct unique_ids {
+      static constexpr bool value = true;
+    };
+
+    template<typename First, typename... Rest>
+    struct unique_ids<First, Rest...> {
+      static constexpr bool value = !uses_id<First::id, Rest...>::value && unique_ids<Rest...>::value;
+    };
+
+    /// Largest size and alignment of any message type
+    template<typename... Types>
+    struct storage_size {
+      static constexpr std::size_t size = 1;
+      static constexpr std::size_t align = 1;
+    };
+
+    template<typename First, typename... Rest>
+    struct storage_size<First, Rest...> {
+      static constexpr std::size_t size =
+        sizeof(typename First::type) > storage_size<Rest...>::size ?
+        sizeof(typename First::type) : storage_size<Rest...>::size;
+      static constexpr std::size_t align =
+        alignof(typename First::type) > storage_size<Rest...>::align ?
+        alignof(typename First::type) : storage_size<Rest...>::align;
+    };
+
+    /// Calls func.apply<Type>() for the StaticMessageType with the id given
+    /**
+       Returns false if no StaticMessageType has the id.
+       The comparisons are against compile-time constants,
+         so the compiler can reduce them to a switch.
+     */
+    template<typename... Types>
+    struct by_id {
+      template<typename Func>
+      static bool apply(id_type, Func&) { return false; }
+    };
+
+    template<typename First, typename... Rest>
+    struct by_id<First, Rest...> {
+      template<typename Func>
+      static bool apply(id_type id, Func& func) {
+        if(id == First::id) {
+          func.template apply<First>();
+          return true;
+        }
+        return by_id<Rest...>::apply(id, func);
+      }
+    };
+
+    /// Calls func.apply<Type>() for the StaticMessageType at the position given
+    template<typename... Types>
+    struct by_index {
+      template<typename Func>
+      static void apply(std::size_t, Func&) { }
+    };
+
+    template<typename First, typename... Rest>
+    struct by_index<First, Rest...> {
+      template<typename Func>
+      static void apply(std::size_t index, Func& func) {
+        if(index == 0) {
+          func.template apply<First>();
+        } else {
+          by_index<Rest...>::apply(index - 1, func);
+        }
+      }
+    };
+  }
+
+  /// A set of message types, fixed at compile time
+  /**
+     An alternative to NetworkIO::message_type, for protocols known in advance.
+     Each template argument is a StaticMessageType.
+     Packing, unpacking and dispatch are resolved at compile time,
+       so they can be inlined, with no virtual calls or heap allocations.
+
+     Received messages are passed to a visitor,
+       which must be callable with a reference to each message type.
+   */
+  template<typename... Types>
+  class StaticMessageSet {
+    static_assert(static_message_detail::unique_ids<Types...>::value,
+                  "Each message type in a StaticMessageSet must have a different id");
+
+  public:
+    /// The StaticMessageType describing message type T
+    template<typename T>
+    using type_of = typename static_message_detail::find_type<T, Types...>::type;
+
+    /// Id of message type T
+    template<typename T>
+    static constexpr id_type id_of() {
+      return type_of<T>::id;
+    }
+
+    /// Packs an object into the output buffer
+    template<typename T>
+    static void pack(const T& obj, Buffer& output) {
+      type_of<T>::unpacker::pack_object(obj, output);
+    }
+
+    /// Defines each message type of the set in the registry given
+    /**
+       Lets the message types also be used by the runtime registry,
+         such as with NetworkSocket::write and NetworkSocket::GetMessage.
+     */
+    static void define(MessageTemplates& templates) {
+      define_type func{templates};
+      for(std::size_t i=0; i<sizeof...(Types); i++) {
+        static_message_detail::by_index<Types...>::apply(i, func);
+      }
+    }
+
+    /// Unpacks a message, passing it to the visitor
+    /**
+       The object is unpacked onto the stack,
+         and only lives for the duration of the visitor.
+       Returns false if the id is not part of the set.
+     */
+    template<typename Visitor>
+    static bool dispatch(id_type id, const char* packed, std::size_t size, Visitor& visitor) {
+      unpack_and_visit<Visitor> func{packed, size, visitor};
+      return static_message_detail::by_id<Types...>::apply(id, func);
+    }
+
+    /// A message of any type in the set, decoded in place.
+    /**
+       Can hold one message at a time, without allocating.
+     */
+    class DecodedMessage {
+    public:
+      DecodedMessage()
+        : m_index(empty_index), m_id(0) { }
+
+      DecodedMessage(DecodedMessage&& other)
+        : m_index(empty_index), m_id(0) {
+        *this = std::move(other);
+      }
+
+      DecodedMessage& operator=(DecodedMessage&& other) {
+        if(this != &other) {
+          reset();
+          if(!other.empty()) {
+            move_from func{&m_storage, &other.m_storage};
+            static_message_detail::by_index<Types...>::apply(other.m_index, func);
+            m_index = other.m_index;
+            m_id = other.m_id;
+            other.reset();
+          }
+        }
+        return *this;
+      }
+
+      DecodedMessage(const DecodedMessage&) = delete;
+      DecodedMessage& operator=(const DecodedMessage&) = delete;
+
+      ~DecodedMessage() {
+        reset();
+      }
+
+      /// Whether a message is currently held
+      bool empty() const { return m_index == empty_index; }
+
+      /// The id of the message held, or 0 if empty
+      id_type id() const { return m_id; }
+
+      /// Whether the message held is of type T
+      template<typename T>
+      bool holds() const {
+        return m_index == static_message_detail::index_of<T, Types...>::value;
+      }
+
+      /// Returns the message held, or nullptr if it is not of type T
+      template<typename T>
+      T* view() {
+        return holds<T>() ? reinterpret_cast<T*>(&m_storage) : nullptr;
+      }
+
+      /// Passes the message held to the visitor
+      /**
+         Returns false if no message is held.
+       */
+      template<typename Visitor>
+      bool visit(Visitor& visitor) {
+        if(empty()) {
+          return false;
+        }
+        visit_storage<Visitor> func{&m_storage, visitor};
+        static_message_detail::by_index<Types...>::apply(m_index, func);
+        return true;
+      }
+
+      /// Destroys the message held
+      void reset() {
+        if(!empty()) {
+          destroy func{&m_storage};
+          static_message_detail::by_index<Types...>::apply(m_index, func);
+          m_index = empty_index;
+          m_id = 0;
+        }
+      }
+
+    private:
+      friend class StaticMessageSet;
+
+      static constexpr std::size_t empty_index = sizeof...(Types);
+
+      struct move_from {
+        void* dest;
+        void* source;
+        template<typename Type>
+        void apply() {
+          typedef typename Type::type T;
+          new (dest) T(std::move(*static_cast<T*>(source)));
+        }
+      };
+
+      struct destroy {
+        void* storage;
+        template<typename Type>
+        void apply() {
+          typedef typename Type::type T;
+          static_cast<T*>(storage)->~T();
+        }
+      };
+
+      template<typename Visitor>
+      struct visit_storage {
+        void* storage;
+        Visitor& visitor;
+        template<typename Type>
+        void apply() {
+          visitor(*static_cast<typename Type::type*>(storage));
+        }
+      };
+
+      typename std::aligned_storage<
+        static_message_detail::storage_size<Types...>::size,
+        static_message_detail::storage_size<Types...>::align>::type m_storage;
+      std::size_t m_index;
+      id_type m_id;
+    };
+
+    /// Unpacks a message into output, replacing any message already held
+    /**
+       Returns false if the id is not part of the set, leaving output empty.
+     */
+    static bool decode(id_type id, const char* packed, std::size_t size, DecodedMessage& output) {
+      output.reset();
+      unpack_into func{packed, size, output};
+      return static_message_detail::by_id<Types...>::apply(id, func);
+    }
+
+  private:
+    struct define_type {
+      MessageTemplates& templates;
+      template<typename Type>
+      void apply() {
+        templates.define<typename Type::type, Type::method>(Type::id, Type::acknowledge);
+      }
+    };
+
+    template<typename Visitor>
+    struct unpack_and_visit {
+      const char* packed;
+      std::size_t size;
+      Visitor& visitor;
+      template<typename Type>
+      void apply() {
+        typename Type::type obj;
+        Type::unpacker::unpack_object(packed, size, obj);
+        visitor(obj);
+      }
+    };
+
+    struct unpack_into {
+      const char* packed;
+      std::size_t size;
+      DecodedMessage& output;
+      template<typename Type>
+      void apply() {
+        typedef typename Type::type T;
+        T* obj = new (&output.m_storage) T();
+        output.m_index = static_message_detail::index_of<T, Types...>::value;
+        output.m_id = Type::id;
+        Type::unpacker::unpack_object(packed, size, *obj);
+      }
+    };
+  };
+
+  template<typename... Types>
+  constexpr std::size_t StaticMessageSet<Types...>::DecodedMessage::empty_index;
+}
+
+#endif /* _STATICMESSAGESET_H_ */
@@ -0,0 +1,16 @@
+#ifndef _UNPACKMODE_H_
+#define _UNPACKMODE_H_
+
+namespace hermes {
+  /// When received messages are unpacked.
+  /**
+     Eager messages are unpacked by the networking thread as soon as they arrive.
+     Lazy messages are queued still packed,
+       and unpacked by whichever thread first views or claims them.
+   */
+  enum class UnpackMode {
+    Eager, Lazy
+  };
+}
+
+#endif /* _UNPACKMODE_H_ */
@@ -1,6 +1,13 @@
 #ifndef _UNPACKEDMESSAGE_H_
 #define _UNPACKEDMESSAGE_H_
 
+#include <cstddef>
+#include <memory>
+
+#include "BlockPool.hh"
+#include "ObjectPool.hh"
+#include "VoidPTypeChecker.hh"
+
 namespace hermes {
   template<typename T>
   class UnpackedMessageHolder;
@@ -11,8 +18,8 @@ namespace hermes {
 
     template<typename T>
     T* view() {
-      if(auto m = dynamic_cast<UnpackedMessageHolder<T>*>(this)) {
-        return m->t.get();
+      if(holds<T>()) {
+        return static_cast<UnpackedMessageHolder<T>*>(unpacked())->t.get();
       } else {
         return nullptr;
       }
@@ -20,22 +27,95 @@ namespace hermes {
 
     template<typename T>
     std::unique_ptr<T> claim() {
-      if(auto m = dynamic_cast<UnpackedMessageHolder<T>*>(this)) {
-        return std::move(m->t);
+      if(holds<T>()) {
+        return std::unique_ptr<T>(static_cast<UnpackedMessageHolder<T>*>(unpacked())->t.release());
       } else {
         return nullptr;
       }
     }
+
+    /// Takes ownership of the message, if it is of type T
+    /**
+       If NetworkIO::message_pool was called for T,
+         the object returns to the pool once destroyed.
+     */
+    template<typename T>
+    pooled_ptr<T> claim_pooled() {
+      if(holds<T>()) {
+        return std::move(static_cast<UnpackedMessageHolder<T>*>(unpacked())->t);
+      } else {
+        return nullptr;
+      }
+    }
+
+    /// Whether the message is of type T
+    /**
+       Never unpacks the message,
+         so it can be used to skip unwanted messages cheaply.
+     */
+    template<typename T>
+    bool holds() const {
+      return m_type == VoidPTypeChecker<T>::get();
+    }
+
+  protected:
+    UnpackedMessage(void* type, bool deferred = false)
+      : m_type(type), m_deferred(deferred) { }
+
+    /// Returns the UnpackedMessageHolder, unpacking it first if needed
+    /**
+       Only called for messages constructed with deferred unpacking.
+     */
+    virtual UnpackedMessage* unpack_deferred() { return this; }
+
+  private:
+    UnpackedMessage* unpacked() {
+      return m_deferred ? unpack_deferred() : this;
+    }
+
+    /// Tag of the type held, from VoidPTypeChecker
+    void* m_type;
+    /// Whether unpacking is deferred until the message is used
+    bool m_deferred;
   };
 
   template<typename T>
   class UnpackedMessageHolder : public UnpackedMessage {
   public:
     UnpackedMessageHolder(std::unique_ptr<T> t)
-      : t(std::move(t)) { }
+      : UnpackedMessage(VoidPTypeChecker<T>::get()), t(t.release()) { }
+
+    UnpackedMessageHolder(pooled_ptr<T> t)
+      : UnpackedMessage(VoidPTypeChecker<T>::get()), t(std::move(t)) { }
 
-    std::unique_ptr<T> t;
+    /// Allocates holders from a pool
+    /**
+       A holder is allocated on the networking thread for every message received,
+         and freed on the consumer's thread.
+     */
+    static void* operator new(std::size_t) {
+      return holder_pool().allocate();
+    }
+
+    static void operator delete(void* ptr) {
+      holder_pool().deallocate(ptr);
+    }
+
+    pooled_ptr<T> t;
+
+  private:
+    /// Maximum number of free holders kept for each message type
+    static constexpr std::size_t max_pooled_holders = 256;
+
+    static BlockPool& holder_pool() {
+      // Never destroyed, as messages may outlive static destruction.
+      static BlockPool* pool = new BlockPool(sizeof(UnpackedMessageHolder), max_pooled_holders);
+      return *pool;
+    }
   };
+
+  template<typename T>
+  constexpr std::size_t UnpackedMessageHolder<T>::max_pooled_holders;
 }
 
 #endif /* _UNPACKEDMESSAGE_H_ */
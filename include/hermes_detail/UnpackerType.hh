@@ -0,0 +1,36 @@
+#ifndef _UNPACKERTYPE_H_
+#define _UNPACKERTYPE_H_
+
+#include "BinaryArchiveUnpacker.hh"
+#include "BoostBinaryUnpacker.hh"
+#include "BoostTextUnpacker.hh"
+#include "PackingMethod.hh"
+#include "PlainOldDataUnpacker.hh"
+
+namespace hermes {
+  /// The MessageUnpacker class used for a type and packing method
+  template<typename T, PackingMethod Method>
+  struct UnpackerType;
+
+  template<typename T>
+  struct UnpackerType<T, PackingMethod::PlainOldData> {
+    typedef PlainOldDataUnpacker<T> type;
+  };
+
+  template<typename T>
+  struct UnpackerType<T, PackingMethod::BoostBinaryArchive> {
+    typedef BoostBinaryUnpacker<T> type;
+  };
+
+  template<typename T>
+  struct UnpackerType<T, PackingMethod::BoostTextArchive> {
+    typedef BoostTextUnpacker<T> type;
+  };
+
+  template<typename T>
+  struct UnpackerType<T, PackingMethod::BinaryArchive> {
+    typedef BinaryArchiveUnpacker<T> type;
+  };
+}
+
+#endif /* _UNPACKERTYPE_H_ */
@@ -0,0 +1,46 @@
+#ifndef _VOIDPTYPECHECKER_H_
+#define _VOIDPTYPECHECKER_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace hermes {
+  /// Gives a unique pointer for each type.
+  /**
+     Comparing the pointers is a cheap test for whether two types are the same,
+       without needing RTTI.
+   */
+  template<typename T>
+  struct VoidPTypeChecker {
+    static char x;
+
+    static void* get() {
+      return &x;
+    }
+  };
+
+  template<typename T>
+  char VoidPTypeChecker<T>::x;
+
+  /// Gives a small index for each type.
+  /**
+     Indices are assigned from 0, in the order that types are first used.
+     Unlike VoidPTypeChecker, can be used to index into an array.
+   */
+  class TypeIndex {
+  public:
+    template<typename T>
+    static std::size_t get() {
+      static const std::size_t index = next()++;
+      return index;
+    }
+
+  private:
+    static std::atomic<std::size_t>& next() {
+      static std::atomic<std::size_t> counter(0);
+      return counter;
+    }
+  };
+}
+
+#endif /* _VOIDPTYPECHECKER_H_ */
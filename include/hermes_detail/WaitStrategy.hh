@@ -0,0 +1,22 @@
+#ifndef _WAITSTRATEGY_H_
+#define _WAITSTRATEGY_H_
+
+namespace hermes {
+  /// How a thread waits for messages, connections, or a socket to close.
+  /**
+     Blocking sleeps until woken by the networking thread,
+       which costs a context switch on every wakeup.
+     Spinning repeatedly checks without sleeping,
+       which responds faster but keeps a core busy.
+   */
+  enum class WaitStrategy {
+    /// Sleep until woken.
+    Block,
+    /// Check repeatedly until done, never sleeping.
+    Spin,
+    /// Check repeatedly for the spin time, then sleep until woken.
+    SpinThenBlock
+  };
+}
+
+#endif /* _WAITSTRATEGY_H_ */
@@ -0,0 +1,38 @@
+#include "hermes_detail/BlockPool.hh"
+
+#include <new>
+
+hermes::BlockPool::BlockPool(std::size_t block_size, std::size_t max_blocks)
+  : m_block_size(block_size), m_max_blocks(max_blocks) {
+  // Deallocating should never need to allocate.
+  m_free.reserve(max_blocks);
+}
+
+hermes::BlockPool::~BlockPool() {
+  for(void* block : m_free) {
+    ::operator delete(block);
+  }
+}
+
+void* hermes::BlockPool::allocate() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_free.empty()) {
+      void* block = m_free.back();
+      m_free.pop_back();
+      return block;
+    }
+  }
+  return ::operator new(m_block_size);
+}
+
+void hermes::BlockPool::deallocate(void* block) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_free.size() < m_max_blocks) {
+      m_free.push_back(block);
+      return;
+    }
+  }
+  ::operator delete(block);
+}
@@ -0,0 +1,107 @@
+#include "hermes_detail/BufferPool.hh"
+
+#include <algorithm>
+
+constexpr std::size_t hermes::BufferPool::min_pooled_size;
+constexpr std::size_t hermes::BufferPool::max_pooled_size;
+constexpr std::size_t hermes::BufferPool::max_buffers_per_class;
+constexpr std::size_t hermes::BufferPool::default_max_pooled_bytes;
+
+hermes::BufferPool::BufferPool()
+  : m_free(release_class(max_pooled_size) + 1),
+    m_pooled_bytes(0), m_max_pooled_bytes(default_max_pooled_bytes),
+    m_hits(0), m_misses(0), m_released(0), m_discarded(0) { }
+
+std::size_t hermes::BufferPool::acquire_class(std::size_t size) {
+  std::size_t size_class = 0;
+  std::size_t class_size = min_pooled_size;
+  while(class_size < size) {
+    class_size *= 2;
+    size_class++;
+  }
+  return size_class;
+}
+
+std::size_t hermes::BufferPool::release_class(std::size_t capacity) {
+  std::size_t size_class = 0;
+  std::size_t class_size = min_pooled_size;
+  while(2*class_size <= capacity) {
+    class_size *= 2;
+    size_class++;
+  }
+  return size_class;
+}
+
+hermes::Buffer hermes::BufferPool::acquire(std::size_t size) {
+  Buffer output;
+
+  if(size <= max_pooled_size) {
+    auto size_class = acquire_class(size);
+    bool reused = false;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto& free = m_free[size_class];
+      if(free.size()) {
+        output = std::move(free.back());
+        free.pop_back();
+        m_pooled_bytes -= output.capacity();
+        reused = true;
+      }
+    }
+
+    if(reused) {
+      m_hits++;
+    } else {
+      m_misses++;
+      // Allocate the full size class, so that the buffer can be reused
+      //   for any size in the class.
+      output.reserve(min_pooled_size << size_class);
+    }
+  } else {
+    m_misses++;
+  }
+
+  output.resize(size);
+  return output;
+}
+
+void hermes::BufferPool::release(Buffer buffer) {
+  auto capacity = buffer.capacity();
+  if(capacity < min_pooled_size) {
+    // Too small to have been allocated from the pool.
+    return;
+  }
+  if(capacity > 2*max_pooled_size) {
+    m_discarded++;
+    return;
+  }
+
+  buffer.clear();
+  auto size_class = std::min(release_class(capacity), m_free.size() - 1);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& free = m_free[size_class];
+  if(free.size() < max_buffers_per_class &&
+     m_pooled_bytes + capacity <= m_max_pooled_bytes) {
+    m_pooled_bytes += capacity;
+    free.push_back(std::move(buffer));
+    m_released++;
+  } else {
+    m_discarded++;
+  }
+}
+
+void hermes::BufferPool::SetMaxPooledBytes(std::size_t max_bytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_max_pooled_bytes = max_bytes;
+}
+
+hermes::BufferPool::Statistics hermes::BufferPool::statistics() const {
+  Statistics output;
+  output.hits = m_hits;
+  output.misses = m_misses;
+  output.released = m_released;
+  output.discarded = m_discarded;
+  return output;
+}
@@ -3,30 +3,63 @@
 #include "hermes_detail/ListenServer.hh"
 
 #include <iostream>
+#include <stdexcept>
 
 #include "hermes_detail/NetworkSocket.hh"
 #include "hermes_detail/MakeUnique.hh"
 
 hermes::ListenServer::ListenServer(hermes::NetworkIO io,
                                    asio::ip::tcp::endpoint endpoint)
-  : m_io(io), m_acceptor(io.internals->io_service,endpoint), m_socket(io.internals->io_service) {
+  : m_io(io) {
 
-  do_accept();
+  for(auto& shard : m_io.internals->shards) {
+    m_acceptors.push_back(make_unique<acceptor_t>(shard->io_service));
+  }
+
+  for(auto& acceptor : m_acceptors) {
+    open_acceptor(*acceptor, endpoint);
+    // If an ephemeral port was requested, all shards must share the one chosen.
+    endpoint = acceptor->acceptor.local_endpoint();
+  }
+
+  for(auto& acceptor : m_acceptors) {
+    do_accept(*acceptor);
+  }
 }
 
 hermes::ListenServer::~ListenServer() {
-  m_acceptor.cancel();
-  m_acceptor.close();
+  for(auto& acceptor : m_acceptors) {
+    acceptor->acceptor.cancel();
+    acceptor->acceptor.close();
+  }
+}
+
+void hermes::ListenServer::open_acceptor(acceptor_t& acceptor, asio::ip::tcp::endpoint endpoint) {
+  acceptor.acceptor.open(endpoint.protocol());
+  acceptor.acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+  if(m_acceptors.size() > 1) {
+    // Lets the kernel spread incoming connections over the shards.
+    typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+    acceptor.acceptor.set_option(reuse_port(true));
+  }
+#else
+  if(m_acceptors.size() > 1) {
+    throw std::runtime_error("Sharded listening requires SO_REUSEPORT");
+  }
+#endif
+  acceptor.acceptor.bind(endpoint);
+  acceptor.acceptor.listen();
 }
 
-void hermes::ListenServer::do_accept() {
-  m_acceptor.async_accept(m_socket,
-                          [this](asio::error_code ec) {
+void hermes::ListenServer::do_accept(acceptor_t& acceptor) {
+  acceptor.acceptor.async_accept(acceptor.socket,
+                          [this,&acceptor](asio::error_code ec) {
                             static int i=0;
                             i++;
                             if (!ec) {
                               auto connection = make_unique<hermes::NetworkSocket>(m_io,
-                                                                                   std::move(m_socket));
+                                                                                   std::move(acceptor.socket));
                               std::lock_guard<std::mutex> lock(m_mutex);
                               m_has_new_connection.notify_one();
                               m_connections.push_back(std::move(connection));
@@ -35,7 +68,7 @@ void hermes::ListenServer::do_accept() {
                             }
 
                             if (ec != asio::error::operation_aborted){
-                              do_accept();
+                              do_accept(acceptor);
                             }
                           });
 }
@@ -47,15 +80,16 @@ std::unique_ptr<hermes::NetworkSocket> hermes::ListenServer::GetConnection() {
 
 std::unique_ptr<hermes::NetworkSocket> hermes::ListenServer::WaitForConnection() {
   std::unique_lock<std::mutex> lock(m_mutex);
-  m_has_new_connection.wait(lock, [this]() { return m_connections.size(); } );
+  m_io.internals->wait(lock, m_has_new_connection,
+                       [this]() { return m_connections.size(); } );
   return pop_if_available();
 }
 
 std::unique_ptr<hermes::NetworkSocket>
 hermes::ListenServer::WaitForConnection(std::chrono::duration<double> duration) {
   std::unique_lock<std::mutex> lock(m_mutex);
-  m_has_new_connection.wait_for(lock, duration,
-                                [this]() { return m_connections.size(); } );
+  m_io.internals->wait_for(lock, m_has_new_connection, duration,
+                           [this]() { return m_connections.size(); } );
   return pop_if_available();
 }
 
@@ -2,37 +2,159 @@
 
 #include "hermes_detail/NetworkIO.hh"
 
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include "hermes_detail/ListenServer.hh"
 #include "hermes_detail/MakeUnique.hh"
 #include "hermes_detail/NetworkSocket.hh"
 
 using asio::ip::tcp;
 
-hermes::NetworkIO::NetworkIO()
-  : internals(nullptr) {
+constexpr std::chrono::microseconds hermes::NetworkIO::default_spin_time;
 
-  internals = std::make_shared<internals_t>();
-  internals->thread = std::thread(
-    [this]() {
-      while (true) {
-        try {
-          internals->io_service.run();
-        } catch (std::exception& e) {
-          continue;
-        }
-        break;
+namespace {
+  void run_io_service(asio::io_service& io_service) {
+    while (true) {
+      try {
+        io_service.run();
+      } catch (std::exception& e) {
+        continue;
       }
-    });
+      break;
+    }
+  }
+
+  /// Pins the calling thread to a single core, where supported.
+  void pin_to_core(unsigned int core) {
+#ifdef __linux__
+    unsigned int num_cores = std::thread::hardware_concurrency();
+    if(num_cores == 0) {
+      return;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core % num_cores, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#else
+    (void)core;
+#endif
+  }
+}
+
+hermes::NetworkIO::internals_t::internals_t(unsigned int num_threads, Threading threading)
+  : num_threads(num_threads), threading(threading),
+    wait_strategy(WaitStrategy::Block),
+    spin_time(std::chrono::steady_clock::duration(default_spin_time).count()),
+    next_shard(0) {
+
+  if(num_threads == 0) {
+    // Run by the caller, from a single thread.
+    shards.push_back(std::unique_ptr<shard_t>(new shard_t(1)));
+  } else if(threading == Threading::Sharded) {
+    for(unsigned int i=0; i<num_threads; i++) {
+      shards.push_back(std::unique_ptr<shard_t>(new shard_t(1)));
+    }
+  } else {
+    shards.push_back(std::unique_ptr<shard_t>(new shard_t(num_threads)));
+  }
+}
+
+hermes::NetworkIO::NetworkIO(unsigned int num_threads, Threading threading)
+  : internals(nullptr) {
+
+  internals = std::make_shared<internals_t>(num_threads, threading);
+
+  // The threads are joined by the internals_t destructor,
+  //   so they may outlive this particular NetworkIO object.
+  if(threading == Threading::Sharded) {
+    for(unsigned int i=0; i<num_threads; i++) {
+      asio::io_service& io_service = internals->shards[i]->io_service;
+      internals->shards[i]->threads.push_back(std::thread(
+        [&io_service,i]() {
+          pin_to_core(i);
+          run_io_service(io_service);
+        }));
+    }
+  } else {
+    internals_t::shard_t& shard = *internals->shards[0];
+    asio::io_service& io_service = shard.io_service;
+    for(unsigned int i=0; i<num_threads; i++) {
+      shard.threads.push_back(std::thread(
+        [&io_service]() { run_io_service(io_service); }));
+    }
+  }
 }
 
 hermes::NetworkIO::~NetworkIO() { }
 
+std::size_t hermes::NetworkIO::internals_t::run_one_until(std::chrono::steady_clock::time_point deadline) {
+  shard_t& shard = *shards[0];
+  std::size_t completions = shard.wake_timer_completions;
+  std::size_t handlers = shard.io_service.poll_one();
+  if(handlers) {
+    return handlers - (shard.wake_timer_completions - completions);
+  }
+
+  // Nothing is ready, so sleep until either a handler or the timer is ready.
+  // A pending wait that expires sooner is left alone, as waking early is harmless.
+  if(!shard.wake_timer_armed || shard.wake_timer.expires_at() > deadline) {
+    // Any pending wait is cancelled, and its handler still counted as a completion.
+    shard.wake_timer.expires_at(deadline);
+    shard.wake_timer_armed = true;
+    shard.wake_timer.async_wait([&shard](asio::error_code ec) {
+        shard.wake_timer_completions++;
+        if(!ec) {
+          shard.wake_timer_armed = false;
+        }
+      });
+  }
+
+  handlers = shard.io_service.run_one();
+  return handlers - (shard.wake_timer_completions - completions);
+}
+
+void hermes::NetworkIO::SetWaitStrategy(WaitStrategy strategy,
+                                        std::chrono::duration<double> spin_time) {
+  internals->spin_time =
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(spin_time).count();
+  internals->wait_strategy = strategy;
+}
+
+std::size_t hermes::NetworkIO::poll() {
+  if(!internals->polling()) {
+    throw std::runtime_error("NetworkIO::poll requires a NetworkIO without networking threads");
+  }
+  internals_t::shard_t& shard = *internals->shards[0];
+  std::size_t completions = shard.wake_timer_completions;
+  std::size_t handlers = shard.io_service.poll();
+  return handlers - (shard.wake_timer_completions - completions);
+}
+
+std::size_t hermes::NetworkIO::run_for(std::chrono::duration<double> duration) {
+  if(!internals->polling()) {
+    throw std::runtime_error("NetworkIO::run_for requires a NetworkIO without networking threads");
+  }
+
+  auto deadline = std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+  std::size_t handlers = 0;
+  while(std::chrono::steady_clock::now() < deadline) {
+    handlers += internals->run_one_until(deadline);
+  }
+  return handlers;
+}
+
 std::unique_ptr<hermes::NetworkSocket> hermes::NetworkIO::connect(std::string server, int port) {
   return connect(server, std::to_string(port));
 }
 
 std::unique_ptr<hermes::NetworkSocket> hermes::NetworkIO::connect(std::string server, std::string port) {
-  tcp::resolver resolver(internals->io_service);
+  tcp::resolver resolver(internals->shards[0]->io_service);
   auto endpoint = resolver.resolve({server,port});
   return make_unique<hermes::NetworkSocket>(*this, endpoint);
 }
@@ -2,48 +2,102 @@
 
 #include "hermes_detail/NetworkSocket.hh"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #include "hermes_detail/NetworkIO.hh"
 
 using asio::ip::tcp;
 
+constexpr std::size_t hermes::NetworkSocket::max_write_buffers;
+constexpr std::size_t hermes::NetworkSocket::default_write_batch_messages;
+constexpr std::size_t hermes::NetworkSocket::default_write_batch_bytes;
+constexpr std::chrono::milliseconds hermes::NetworkSocket::default_acknowledge_interval;
+constexpr std::size_t hermes::NetworkSocket::read_buffer_size;
+
 hermes::NetworkSocket::NetworkSocket(NetworkIO io,
                                      asio::ip::tcp::resolver::iterator endpoint)
-  : m_io(io), m_socket(m_io.internals->io_service),
-    m_read_loop_started(false), m_callbacks_running(0), m_writer_running(false),
-    m_unacknowledged_messages(0) {
+  : m_io(io), m_socket(m_io.internals->next_io_service()), m_strand(m_socket.get_io_service()),
+    m_read_loop_started(false), m_callbacks_running(0),
+    m_read_buffer(read_buffer_size), m_read_start(0), m_read_end(0),
+    m_read_queue_max_messages(0), m_read_queue_resume_messages(0),
+    m_read_paused(false), m_read_loop_stopped(false),
+    m_write_messages_queued(0), m_write_bytes_queued(0), m_current_write_bytes(0),
+    m_write_queue_max_messages(0), m_write_queue_max_bytes(0),
+    m_write_queue_policy(WriteQueueFull::Block), m_write_queue_was_full(false),
+    m_flushing_writes(false),
+    m_write_low_water_messages(0), m_write_low_water_bytes(0),
+    m_writer_running(false),
+    m_write_batch_messages(default_write_batch_messages),
+    m_write_batch_bytes(default_write_batch_bytes),
+    m_acknowledge_writes(true), m_unpack_lazily(false), m_unacknowledged_messages(0),
+    m_acknowledge_timer(m_socket.get_io_service()),
+    m_acknowledge_interval(default_acknowledge_interval),
+    m_acknowledge_scheduled(false), m_unsent_acknowledges(0) {
 
   CallbackCounter counter(this);
   asio::async_connect(m_socket, endpoint,
-                      [this,counter](asio::error_code ec, tcp::resolver::iterator) {
+                      m_strand.wrap([this,counter](asio::error_code ec, tcp::resolver::iterator) {
                         if (!ec) {
                           start_read_loop();
                         }
-                      });
+                      }));
 }
 
 hermes::NetworkSocket::NetworkSocket(NetworkIO io,
                                      asio::ip::tcp::socket socket)
-  : m_io(io), m_socket(std::move(socket)),
-    m_read_loop_started(false), m_callbacks_running(0), m_writer_running(false),
-    m_unacknowledged_messages(0) {
+  : m_io(io), m_socket(std::move(socket)), m_strand(m_socket.get_io_service()),
+    m_read_loop_started(false), m_callbacks_running(0),
+    m_read_buffer(read_buffer_size), m_read_start(0), m_read_end(0),
+    m_read_queue_max_messages(0), m_read_queue_resume_messages(0),
+    m_read_paused(false), m_read_loop_stopped(false),
+    m_write_messages_queued(0), m_write_bytes_queued(0), m_current_write_bytes(0),
+    m_write_queue_max_messages(0), m_write_queue_max_bytes(0),
+    m_write_queue_policy(WriteQueueFull::Block), m_write_queue_was_full(false),
+    m_flushing_writes(false),
+    m_write_low_water_messages(0), m_write_low_water_bytes(0),
+    m_writer_running(false),
+    m_write_batch_messages(default_write_batch_messages),
+    m_write_batch_bytes(default_write_batch_bytes),
+    m_acknowledge_writes(true), m_unpack_lazily(false), m_unacknowledged_messages(0),
+    m_acknowledge_timer(m_socket.get_io_service()),
+    m_acknowledge_interval(default_acknowledge_interval),
+    m_acknowledge_scheduled(false), m_unsent_acknowledges(0) {
 
   CallbackCounter counter(this);
-  m_io.internals->io_service.post( [this,counter]() { start_read_loop(); });
+  m_strand.post( [this,counter]() { start_read_loop(); });
 }
 
 hermes::NetworkSocket::~NetworkSocket() {
-  std::unique_lock<std::mutex> lock(m_unacknowledged_mutex);
-  m_all_messages_acknowledged.wait_for(
-    lock, std::chrono::seconds(5),
-    [this](){ return !m_socket.is_open() || m_unacknowledged_messages == 0; });
+  // Acknowledge everything received, rather than leaving it to the timer,
+  //   as the peer may be waiting on the acknowledge before it can close.
+  {
+    CallbackCounter counter(this);
+    m_strand.post( [this,counter]() { flush_acknowledges(); } );
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_unacknowledged_mutex);
+    m_io.internals->wait_for(
+      lock, m_all_messages_acknowledged, std::chrono::seconds(5),
+      [this](){ return !m_socket.is_open() || m_unacknowledged_messages == 0; });
+  }
+
+  // Closing the socket would discard the acknowledge, if still queued.
+  {
+    std::unique_lock<std::mutex> lock(m_write_space_mutex);
+    m_io.internals->wait_for(
+      lock, m_write_space, std::chrono::seconds(1),
+      [this](){ return !m_socket.is_open() ||
+                       (m_flushing_writes && m_write_messages_queued == 0); });
+  }
 
   close_socket();
 
   std::unique_lock<std::mutex> lock_all_finished(m_all_callbacks_finished_mutex);
-  m_all_callbacks_finished.wait(lock_all_finished,
-                                [this] () { return m_callbacks_running==0; } );
+  m_io.internals->wait(lock_all_finished, m_all_callbacks_finished,
+                       [this] () { return m_callbacks_running==0; } );
 }
 
 void hermes::NetworkSocket::close_socket() {
@@ -60,11 +114,25 @@ void hermes::NetworkSocket::close_socket() {
 
   m_socket_closed.notify_all();
   m_received_message.notify_all();
+  {
+    std::lock_guard<std::mutex> lock_space(m_write_space_mutex);
+    m_write_space.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock_acknowledged(m_unacknowledged_mutex);
+    m_all_messages_acknowledged.notify_all();
+  }
+
+  // The timer may only be touched from within the strand.
+  CallbackCounter counter(this);
+  m_strand.post(
+    [this,counter]() { m_acknowledge_timer.cancel(); }
+  );
 }
 
 void hermes::NetworkSocket::WaitForClose() {
   std::unique_lock<std::mutex> lock(m_close_mutex);
-  m_socket_closed.wait(lock, [this](){ return !m_socket.is_open(); });
+  m_io.internals->wait(lock, m_socket_closed, [this](){ return !m_socket.is_open(); });
 }
 
 void hermes::NetworkSocket::start_read_loop() {
@@ -74,155 +142,416 @@ void hermes::NetworkSocket::start_read_loop() {
 
   asio::socket_base::linger option(true,1000);
   m_socket.set_option(option);
-  do_read_header();
+
+  // Writes are already batched, and acknowledges carried on outgoing messages.
+  // Nagle's algorithm would only delay them further.
+  m_socket.set_option(asio::ip::tcp::no_delay(true));
+
+  do_read();
 }
 
-void hermes::NetworkSocket::do_read_header() {
+void hermes::NetworkSocket::do_read() {
   CallbackCounter counter(this);
-  asio::async_read(m_socket,
-                   asio::buffer(m_current_read.header.arr, header_size),
-                   [this,counter](asio::error_code ec, std::size_t /*length*/) {
-                     if (!ec) {
-                       if (m_current_read.header.packed.acknowledge==0) {
-                         do_read_body();
-                       } else {
-                         m_unacknowledged_messages--;
-                         if(m_unacknowledged_messages == 0) {
-                           m_all_messages_acknowledged.notify_one();
-                         }
-                         do_read_header();
-                       }
+  m_socket.async_read_some(
+    asio::buffer(m_read_buffer.data() + m_read_end, m_read_buffer.size() - m_read_end),
+    m_strand.wrap([this,counter](asio::error_code ec, std::size_t length) {
+      if (!ec) {
+        m_read_end += length;
+        parse_read_buffer();
+      } else if (ec != asio::error::operation_aborted){
+        close_socket();
+      }
+    }));
+}
 
-                     } else if (ec != asio::error::operation_aborted){
-                       close_socket();
-                     }
-                   });
+void hermes::NetworkSocket::parse_read_buffer() {
+  while(!m_read_paused && m_read_end - m_read_start >= header_size) {
+    network_header header;
+    memcpy(header.arr, m_read_buffer.data() + m_read_start, header_size);
+
+    std::size_t frame_size = header_size + header.packed.size;
+    if(m_read_start + frame_size > m_read_end) {
+      if(frame_size > m_read_buffer.size()) {
+        // Will never fit in the read buffer, so read the rest directly into the body.
+        m_read_start += header_size;
+        receive_acknowledges(header);
+        do_read_large_body(header);
+        return;
+      } else {
+        // Wait for the rest of the frame.
+        break;
+      }
+    }
+
+    m_read_start += header_size;
+    receive_acknowledges(header);
+    if(header.packed.acknowledge == 0) {
+      receive_message(header, m_read_buffer.data() + m_read_start, header.packed.size);
+      m_read_start += header.packed.size;
+    }
+  }
+
+  // Move any partial frame to the front of the buffer, to make room for the rest.
+  std::size_t remaining = m_read_end - m_read_start;
+  if(remaining && m_read_start) {
+    memmove(m_read_buffer.data(), m_read_buffer.data() + m_read_start, remaining);
+  }
+  m_read_start = 0;
+  m_read_end = remaining;
+
+  if(m_read_paused) {
+    // Stop reading until the consumer catches up.
+    // The OS buffers fill, and TCP flow control slows the sender.
+    m_read_loop_stopped = true;
+    return;
+  }
+
+  do_read();
 }
 
-void hermes::NetworkSocket::do_read_body() {
-  m_current_read.body = std::string(); // In case it is a moved-from value
-  m_current_read.body.resize(m_current_read.header.packed.size, '\0');
+void hermes::NetworkSocket::resume_reading() {
+  if(m_read_loop_stopped && !m_read_paused) {
+    m_read_loop_stopped = false;
+    parse_read_buffer();
+  }
+}
+
+void hermes::NetworkSocket::do_read_large_body(network_header header) {
+  m_current_read.header = header;
+  m_current_read.body = m_io.internals->buffer_pool.acquire(header.packed.size);
+
+  // Part of the body may already have been read into the read buffer.
+  std::size_t already_read = m_read_end - m_read_start;
+  memcpy(m_current_read.body.data(), m_read_buffer.data() + m_read_start, already_read);
+  m_read_start = 0;
+  m_read_end = 0;
 
   CallbackCounter counter(this);
   asio::async_read(m_socket,
-                   asio::buffer(&m_current_read.body[0], m_current_read.body.size()),
-                   [this,counter](asio::error_code ec, std::size_t /*length*/) {
+                   asio::buffer(m_current_read.body.data() + already_read,
+                                m_current_read.body.size() - already_read),
+                   m_strand.wrap([this,counter](asio::error_code ec, std::size_t /*length*/) {
                      if (!ec) {
-                       write_acknowledge(m_current_read.header);
-                       unpack_message();
-                       do_read_header();
+                       receive_message(m_current_read.header,
+                                       m_current_read.body.data(), m_current_read.body.size(),
+                                       &m_current_read.body);
+                       m_io.internals->buffer_pool.release(std::move(m_current_read.body));
+                       parse_read_buffer();
                      } else if (ec != asio::error::operation_aborted){
                        close_socket();
                      }
-                   });
+                   }));
 }
 
-void hermes::NetworkSocket::unpack_message() {
-  auto& unpacker = m_io.internals->message_templates.get_by_id(m_current_read.header.packed.id);
-  auto unpacked = unpacker.unpack(m_current_read.body);
-  m_current_read.body = std::string();
+void hermes::NetworkSocket::receive_acknowledges(const network_header& header) {
+  auto acknowledged = header.packed.acknowledge_count;
+  if (acknowledged) {
+    m_unacknowledged_messages -= acknowledged;
+    if(m_unacknowledged_messages == 0) {
+      std::lock_guard<std::mutex> lock(m_unacknowledged_mutex);
+      m_all_messages_acknowledged.notify_one();
+    }
+  }
+}
+
+void hermes::NetworkSocket::receive_message(const network_header& header,
+                                            const char* body, std::size_t size,
+                                            Buffer* owned_body) {
+  if (!header.packed.no_acknowledge) {
+    m_unsent_acknowledges++;
+    schedule_acknowledge();
+  }
+  unpack_message(header.packed.id, body, size, owned_body);
+}
 
-  std::lock_guard<std::mutex> lock_callbacks(m_callback_mutex);
-  for(auto& callback : m_callbacks) {
-    bool res = callback->apply_on(*unpacked);
-    if(res) {
+void hermes::NetworkSocket::unpack_message(id_type id, const char* body, std::size_t size,
+                                           Buffer* owned_body) {
+  if(m_static_callbacks && m_static_callbacks(id, body, size)) {
+    return;
+  }
+
+  if(id < m_raw_callbacks.size() && m_raw_callbacks[id]) {
+    m_raw_callbacks[id](id, body, size);
+    return;
+  }
+
+  auto& unpacker = m_io.internals->message_templates.get_by_id(id);
+  MessageCallback* callback = (id < m_callbacks.size()) ? m_callbacks[id].get() : nullptr;
+
+  std::unique_ptr<UnpackedMessage> unpacked;
+  if(m_unpack_lazily && !callback) {
+    // Leave the unpacking to whoever retrieves the message.
+    Buffer packed;
+    if(owned_body) {
+      packed = std::move(*owned_body);
+    } else {
+      packed = m_io.internals->buffer_pool.acquire(size);
+      memcpy(packed.data(), body, size);
+    }
+    std::shared_ptr<BufferPool> pool(m_io.internals, &m_io.internals->buffer_pool);
+    unpacked = make_unique<LazyUnpackedMessage>(unpacker, std::move(packed), std::move(pool));
+  } else {
+    unpacked = unpacker.unpack(body, size);
+    if(callback && callback->apply_on(*unpacked)) {
       return;
     }
   }
 
   std::lock_guard<std::mutex> lock(m_read_lock);
   m_read_messages.push_back(std::move(unpacked));
+  std::size_t max_messages = m_read_queue_max_messages;
+  if(max_messages && m_read_messages.size() >= max_messages) {
+    m_read_paused = true;
+  }
   m_received_message.notify_one();
 }
 
-void hermes::NetworkSocket::write_direct(Message message) {
+bool hermes::NetworkSocket::write_direct(Message message, bool try_only) {
   {
     std::unique_lock<std::mutex> lock(m_open_mutex);
-    m_can_write.wait_for(lock, std::chrono::seconds(1),
-                         [this]() { return bool(m_read_loop_started); });
+    m_io.internals->wait_for(lock, m_can_write, std::chrono::seconds(1),
+                             [this]() { return bool(m_read_loop_started); });
   }
 
-  if (message.header.packed.size != message.body.size()) {
+  if (message.header.packed.size != message.body_size()) {
     throw std::runtime_error("Incorrect message header");
   }
   if (message.header.packed.size > max_message_size) {
     throw std::runtime_error("Message size exceeds maximum");
   }
 
-  {
-    std::lock_guard<std::mutex> lock(m_write_lock);
-    m_write_messages.push_back(std::move(message));
+  std::size_t message_bytes = header_size + message.body_size();
+  if (!write_queue_has_room(message_bytes)) {
+    m_write_queue_was_full = true;
+
+    if (try_only) {
+      return false;
+    } else if (m_write_queue_policy == WriteQueueFull::Throw) {
+      throw std::runtime_error("Write queue is full");
+    } else {
+      std::unique_lock<std::mutex> lock(m_write_space_mutex);
+      m_io.internals->wait(lock, m_write_space, [this,message_bytes]() {
+          return write_queue_has_room(message_bytes) || !IsOpen(); });
+    }
+  }
+
+  // Counted before queuing, so that the acknowledge cannot arrive first.
+  if (!message.header.packed.no_acknowledge) {
+    m_unacknowledged_messages++;
   }
 
+  m_write_messages_queued++;
+  m_write_bytes_queued += message_bytes;
+  m_write_queue.push(std::move(message));
+
   // Start the writing
-  m_unacknowledged_messages++;
   start_writer();
+  return true;
+}
+
+bool hermes::NetworkSocket::write_queue_has_room(std::size_t message_bytes) {
+  std::size_t queued_messages = m_write_messages_queued;
+  if (queued_messages == 0) {
+    return true;
+  }
+
+  std::size_t max_messages = m_write_queue_max_messages;
+  std::size_t max_bytes = m_write_queue_max_bytes;
+  return ( (max_messages == 0 || queued_messages < max_messages) &&
+           (max_bytes == 0 || m_write_bytes_queued + message_bytes <= max_bytes) );
+}
+
+void hermes::NetworkSocket::write_batch_finished(std::size_t messages, std::size_t bytes) {
+  m_write_messages_queued -= messages;
+  m_write_bytes_queued -= bytes;
+
+  if (m_flushing_writes && m_write_messages_queued == 0) {
+    std::lock_guard<std::mutex> lock(m_write_space_mutex);
+    m_write_space.notify_all();
+  }
+
+  if (!m_write_queue_was_full) {
+    return;
+  }
+
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> lock(m_write_space_mutex);
+    m_write_space.notify_all();
+
+    if (std::size_t(m_write_messages_queued) <= m_write_low_water_messages &&
+        m_write_bytes_queued <= m_write_low_water_bytes) {
+      m_write_queue_was_full = false;
+      callback = m_write_low_water_callback;
+    }
+  }
+
+  if (callback) {
+    callback();
+  }
+}
+
+void hermes::NetworkSocket::SetWriteQueueLimit(std::size_t max_messages, std::size_t max_bytes,
+                                               WriteQueueFull policy) {
+  m_write_queue_max_messages = max_messages;
+  m_write_queue_max_bytes = max_bytes;
+  m_write_queue_policy = policy;
+
+  // Let blocked writers re-check against the new limit.
+  std::lock_guard<std::mutex> lock(m_write_space_mutex);
+  m_write_space.notify_all();
+}
+
+void hermes::NetworkSocket::SetWriteQueueLowWater(std::size_t max_messages, std::size_t max_bytes,
+                                                  std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(m_write_space_mutex);
+  m_write_low_water_messages = max_messages;
+  m_write_low_water_bytes = max_bytes;
+  m_write_low_water_callback = callback;
 }
 
 void hermes::NetworkSocket::start_writer() {
+  // Only hand off to the io_service if the writer is idle.
+  // A running writer will pick up the new message on its next batch.
+  if (!m_writer_running.exchange(true)) {
+    CallbackCounter counter(this);
+    m_strand.post( [this,counter]() { do_write(); } );
+  }
+}
+
+void hermes::NetworkSocket::schedule_acknowledge() {
+  if(m_acknowledge_scheduled) {
+    return;
+  }
+  m_acknowledge_scheduled = true;
+
   CallbackCounter counter(this);
-  m_io.internals->io_service.post(
-    [this,counter]() {
-      if (!m_writer_running) {
-        m_writer_running = true;
-        do_write_header();
+  m_acknowledge_timer.expires_from_now(m_acknowledge_interval);
+  m_acknowledge_timer.async_wait(
+    m_strand.wrap([this,counter](asio::error_code ec) {
+      m_acknowledge_scheduled = false;
+      if (!ec && m_unsent_acknowledges) {
+        write_acknowledge(m_unsent_acknowledges);
+        m_unsent_acknowledges = 0;
       }
-    });
+    }));
 }
 
-void hermes::NetworkSocket::write_acknowledge(network_header header) {
-  header.packed.acknowledge = 1;
+void hermes::NetworkSocket::write_acknowledge(size_type count) {
   Message message;
-  message.header = header;
+  message.header.packed.size = 0;
+  message.header.packed.id = 0;
+  message.header.packed.acknowledge = 1;
+  message.header.packed.no_acknowledge = 1;
+  message.header.packed.acknowledge_count = count;
 
-  {
-    std::lock_guard<std::mutex> lock(m_write_lock);
-    m_write_messages.push_back(message);
-  }
+  m_write_messages_queued++;
+  m_write_bytes_queued += header_size;
+  m_write_queue.push(std::move(message));
 
   start_writer();
 }
 
-void hermes::NetworkSocket::do_write_header() {
-  {
-    std::lock_guard<std::mutex> lock(m_write_lock);
-    if(m_write_messages.size()) {
-      m_current_write = std::move(m_write_messages.front());
-      m_write_messages.pop_front();
-    } else {
-      m_writer_running = false;
+void hermes::NetworkSocket::flush_acknowledges() {
+  m_acknowledge_timer.cancel();
+  if (m_unsent_acknowledges) {
+    write_acknowledge(m_unsent_acknowledges);
+    m_unsent_acknowledges = 0;
+  }
+
+  std::lock_guard<std::mutex> lock(m_write_space_mutex);
+  m_flushing_writes = true;
+  m_write_space.notify_all();
+}
+
+void hermes::NetworkSocket::SetAcknowledgeInterval(std::chrono::duration<double> interval) {
+  auto steady_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+  CallbackCounter counter(this);
+  m_strand.post(
+    [this,counter,steady_interval]() { m_acknowledge_interval = steady_interval; }
+  );
+}
+
+void hermes::NetworkSocket::SetAcknowledgeMode(AcknowledgeMode acknowledge) {
+  m_acknowledge_writes = (acknowledge == AcknowledgeMode::Acknowledge);
+}
+
+void hermes::NetworkSocket::SetUnpackMode(UnpackMode mode) {
+  m_unpack_lazily = (mode == UnpackMode::Lazy);
+}
+
+void hermes::NetworkSocket::do_write() {
+  m_current_writes.clear();
+  m_write_buffers.clear();
+
+  m_write_queue.pop_all(m_write_messages);
+  if(m_write_messages.empty()) {
+    m_writer_running = false;
+
+    // A message may have been pushed after the queue was checked,
+    //   but before m_writer_running was cleared.
+    // If so, and no other writer has been started, keep writing.
+    if(m_write_queue.empty() || m_writer_running.exchange(true)) {
       return;
     }
+    m_write_queue.pop_all(m_write_messages);
+  }
+
+  // Take as many queued messages as fit in one batch.
+  // The first message is always taken, even if it exceeds the byte limit.
+  std::size_t max_messages = std::max<std::size_t>(m_write_batch_messages, 1);
+  std::size_t max_bytes = m_write_batch_bytes;
+  std::size_t batch_bytes = 0;
+  std::size_t batch_buffers = 0;
+  while(m_write_messages.size() && m_current_writes.size() < max_messages) {
+    std::size_t body_size = m_write_messages.front().body_size();
+    std::size_t message_bytes = header_size + body_size;
+    std::size_t message_buffers = body_size ? 2 : 1;
+    if(m_current_writes.size() &&
+       (batch_bytes + message_bytes > max_bytes ||
+        batch_buffers + message_buffers > max_write_buffers)) {
+      break;
+    }
+    batch_bytes += message_bytes;
+    batch_buffers += message_buffers;
+    m_current_writes.push_back(std::move(m_write_messages.front()));
+    m_write_messages.pop_front();
+  }
+  m_current_write_bytes = batch_bytes;
+
+  // Acknowledges ride along with the outgoing batch,
+  //   rather than waiting for the acknowledge timer.
+  m_current_writes.front().header.packed.acknowledge_count += m_unsent_acknowledges;
+  m_unsent_acknowledges = 0;
+
+  // Gather all headers and bodies, so that the batch goes out in a single write.
+  for(auto& message : m_current_writes) {
+    m_write_buffers.push_back(asio::buffer(message.header.arr, header_size));
+    if(message.body_size()) {
+      m_write_buffers.push_back(asio::buffer(message.body_data(), message.body_size()));
+    }
   }
 
-  // Write the buffer to the socket.
   CallbackCounter counter(this);
-  asio::async_write(m_socket,
-                    asio::buffer(m_current_write.header.arr, header_size),
-                    [this,counter](asio::error_code ec, std::size_t /*length*/) {
+  asio::async_write(m_socket, m_write_buffers,
+                    m_strand.wrap([this,counter](asio::error_code ec, std::size_t /*length*/) {
+                      // Release the bodies of the batch, now that they are no longer needed.
+                      for(auto& message : m_current_writes) {
+                        m_io.internals->buffer_pool.release(std::move(message.body));
+                      }
+                      write_batch_finished(m_current_writes.size(), m_current_write_bytes);
+                      m_current_writes.clear();
                       if (!ec) {
-                        if(m_current_write.header.packed.acknowledge == 0) {
-                          do_write_body();
-                        } else {
-                          do_write_header();
-                        }
+                        do_write();
                       } else if (ec != asio::error::operation_aborted){
                         close_socket();
                       }
-                    });
+                    }));
 }
 
-void hermes::NetworkSocket::do_write_body() {
-  CallbackCounter counter(this);
-  asio::async_write(m_socket,
-                    asio::buffer(m_current_write.body.c_str(), m_current_write.body.size()),
-                    [this,counter](asio::error_code ec, std::size_t /*length*/) {
-                      if(!ec) {
-                        do_write_header();
-                      } else if (ec != asio::error::operation_aborted){
-                        close_socket();
-                      }
-                    });
+void hermes::NetworkSocket::SetWriteBatchLimit(std::size_t max_messages, std::size_t max_bytes) {
+  m_write_batch_messages = max_messages;
+  m_write_batch_bytes = max_bytes;
 }
 
 bool hermes::NetworkSocket::HasNewMessage() {
@@ -232,8 +561,11 @@ bool hermes::NetworkSocket::HasNewMessage() {
 }
 
 int hermes::NetworkSocket::WriteMessagesQueued() {
-  std::lock_guard<std::mutex> lock(m_write_lock);
-  return m_write_messages.size();
+  return m_write_messages_queued;
+}
+
+std::size_t hermes::NetworkSocket::WriteBytesQueued() {
+  return m_write_bytes_queued;
 }
 
 bool hermes::NetworkSocket::IsOpen() {
@@ -247,15 +579,16 @@ std::unique_ptr<hermes::UnpackedMessage> hermes::NetworkSocket::GetMessage() {
 
 std::unique_ptr<hermes::UnpackedMessage> hermes::NetworkSocket::WaitForMessage() {
   std::unique_lock<std::mutex> lock(m_read_lock);
-  m_received_message.wait(lock, [this]() { return m_read_messages.size() || !IsOpen(); } );
+  m_io.internals->wait(lock, m_received_message,
+                       [this]() { return m_read_messages.size() || !IsOpen(); } );
   return pop_if_available();
 }
 
 std::unique_ptr<hermes::UnpackedMessage>
 hermes::NetworkSocket::WaitForMessage(std::chrono::duration<double> duration) {
   std::unique_lock<std::mutex> lock(m_read_lock);
-  m_received_message.wait_for(lock, duration,
-                              [this]() { return m_read_messages.size() || !IsOpen(); } );
+  m_io.internals->wait_for(lock, m_received_message, duration,
+                           [this]() { return m_read_messages.size() || !IsOpen(); } );
   return pop_if_available();
 }
 
@@ -263,12 +596,49 @@ std::unique_ptr<hermes::UnpackedMessage> hermes::NetworkSocket::pop_if_available
   if(m_read_messages.size()) {
     auto output = std::move(m_read_messages.front());
     m_read_messages.pop_front();
+    resume_if_drained();
     return output;
   } else {
     return nullptr;
   }
 }
 
+void hermes::NetworkSocket::resume_if_drained() {
+  if(m_read_paused && m_read_messages.size() <= m_read_queue_resume_messages) {
+    m_read_paused = false;
+    CallbackCounter counter(this);
+    m_strand.post( [this,counter]() { resume_reading(); } );
+  }
+}
+
+void hermes::NetworkSocket::SetReadQueueLimit(std::size_t max_messages, std::size_t resume_messages) {
+  m_read_queue_max_messages = max_messages;
+  m_read_queue_resume_messages = resume_messages;
+
+  // If the new limit is no longer exceeded, reading can start again.
+  std::lock_guard<std::mutex> lock(m_read_lock);
+  if(m_read_paused && (max_messages == 0 || m_read_messages.size() < max_messages)) {
+    m_read_paused = false;
+    CallbackCounter counter(this);
+    m_strand.post( [this,counter]() { resume_reading(); } );
+  }
+}
+
+void hermes::NetworkSocket::add_raw_callback(id_type id,
+                                             std::function<void(id_type, const char*, std::size_t)> func) {
+  CallbackCounter counter(this);
+  m_strand.post(
+    [this,counter,id,func]() {
+      if(id >= m_raw_callbacks.size()) {
+        m_raw_callbacks.resize(id + 1);
+      }
+      // The first callback for each id takes precedence.
+      if(!m_raw_callbacks[id]) {
+        m_raw_callbacks[id] = func;
+      }
+    });
+}
+
 void hermes::NetworkSocket::initialize_callback() {
   std::unique_ptr<MessageCallback> new_callback = nullptr;
   {
@@ -277,7 +647,12 @@ void hermes::NetworkSocket::initialize_callback() {
     m_new_callbacks.pop_front();
   }
 
-  std::lock_guard<std::mutex> lock_callbacks(m_callback_mutex);
+  id_type id = new_callback->id();
+  if(id < m_callbacks.size() && m_callbacks[id]) {
+    // The first callback for each message type takes precedence.
+    return;
+  }
+
   std::lock_guard<std::mutex> lock_messages(m_read_lock);
 
   // Try callback on all messages, remove any that return true.
@@ -286,6 +661,10 @@ void hermes::NetworkSocket::initialize_callback() {
                                          return new_callback->apply_on(*msg);
                                        }),
                         m_read_messages.end());
+  resume_if_drained();
 
-  m_callbacks.push_back(std::move(new_callback));
+  if(id >= m_callbacks.size()) {
+    m_callbacks.resize(id + 1);
+  }
+  m_callbacks[id] = std::move(new_callback);
 }